@@ -0,0 +1,51 @@
+# PlatformIO post-build script: per translation unit .data/.bss report.
+#
+# Static RAM is what the stack and the heap (SSD1306 frame buffer) have to share
+# out of 2 KB, so print it per object file after every link and warn once the
+# total leaves less than the configured headroom.
+#
+# The Arduino core builds with -flto, whose slim objects carry no section sizes.
+# platformio.ini adds -ffat-lto-objects so avr-size can still read them; the
+# numbers are before link-time optimisation, the total line comes from the ELF.
+
+import os
+import subprocess
+
+Import("env")
+
+SRAM_SIZE = 2048
+
+
+def size_of(files):
+    # Berkeley format: text data bss dec hex filename
+    out = subprocess.check_output([env.subst("$SIZETOOL")] + files, universal_newlines=True)
+    rows = []
+    for line in out.splitlines()[1:]:
+        fields = line.split(None, 5)
+        if len(fields) == 6:
+            rows.append((int(fields[1]), int(fields[2]), fields[5]))
+    return rows
+
+
+def memory_report(source, target, env):
+    build_dir = env.subst("$BUILD_DIR")
+    objects = []
+    for root, _, files in os.walk(os.path.join(build_dir, "src")):
+        objects += [os.path.join(root, f) for f in files if f.endswith(".o")]
+    if not objects:
+        return
+
+    print("Static RAM per translation unit (before LTO):")
+    print("%6s %6s  %s" % ("data", "bss", "file"))
+    for data, bss, name in sorted(size_of(sorted(objects)), key=lambda r: r[0] + r[1], reverse=True):
+        print("%6d %6d  %s" % (data, bss, os.path.relpath(name, build_dir)))
+
+    data, bss, _ = size_of([str(target[0])])[0]
+    headroom = int(env.GetProjectOption("custom_min_free_ram", "1280"))
+    free = SRAM_SIZE - data - bss
+    print("Firmware: .data %d + .bss %d = %d bytes, %d left for heap and stack" % (data, bss, data + bss, free))
+    if free < headroom:
+        print("WARNING: less than %d bytes of SRAM left for heap and stack" % headroom)
+
+
+env.AddPostAction("$BUILD_DIR/${PROGNAME}.elf", memory_report)
@@ -0,0 +1,103 @@
+#!/usr/bin/env python3
+# Turns the 't' serial dump or a 'T' live trace (TraceRecorder) into a readable
+# timeline of inputs and outputs.
+#
+#   pio device monitor | tee session.log     # press 't' when the problem shows up
+#   python3 scripts/trace_decode.py session.log
+#
+# Times are relative to the first entry. Dump timestamps are 16-bit
+# milliseconds, so gaps longer than 65 s between two entries cannot be told
+# apart from shorter ones; a live trace sends a keepalive before that. Encoder A
+# positions are rebuilt backwards from the pulse count in the TRACE header, or
+# forwards from the one in the LIVE header.
+
+import sys
+
+KINDS = ["BUTTON", "ENCODER_A", "ENCODER_B", "GLITCH", "ENDSTOP", "STATE", "MOTOR", "FRAME", "DIGITS", "COMMAND",
+         "CLOCK"]
+STATES = ["IDLE", "MOVING_UP", "MOVING_DOWN", "CALIBRATING", "PRESET_MODE", "PRESET_EDIT_MODE", "CHARACTERIZING"]
+BUTTONS = ["UP", "DOWN"]
+
+
+def parse(lines):
+    """(end time, end pulses), entries and lost entries (None for a dump) of the first complete trace."""
+    header = None
+    live = None  # (time, pulses) so far in a live trace
+    entries = []
+    lost = 0
+    for line in lines:
+        line = line.strip()
+        if line.startswith("TRACE,"):
+            _, end_time, end_pulses = line.split(",")
+            header = (int(end_time), int(end_pulses))
+            live = None
+            entries = []
+        elif line.startswith("LIVE,"):
+            _, start_time, start_pulses = line.split(",")
+            header = (0, 0)
+            live = (int(start_time), int(start_pulses))
+            entries = []
+        elif line == "END" and header is not None:
+            if live is None:
+                return header, entries, None
+            return live, entries, lost
+        elif line.startswith("LOST,") and live is not None:
+            lost += int(line[5:])
+        elif header is not None:
+            fields = line.split(",")
+            if len(fields) == 3 and all(f.lstrip("-").isdigit() for f in fields):
+                time, kind, data = (int(f) for f in fields)
+                if live is not None:
+                    # Live lines carry the time since the previous line
+                    time += live[0]
+                    pulses = live[1] + (data if KINDS[kind] == "ENCODER_A" else 0)
+                    live = (time, pulses)
+                    time &= 0xFFFF
+                entries.append((time, kind, data))
+    sys.exit("no complete trace found")
+
+
+def main():
+    with open(sys.argv[1]) if len(sys.argv) > 1 else sys.stdin as f:
+        (end_time, end_pulses), entries, lost = parse(f)
+
+    pulses = end_pulses - sum(data for _, kind, data in entries if KINDS[kind] == "ENCODER_A")
+    elapsed = 0
+    previous = entries[0][0] if entries else 0
+    for time, kind, data in entries:
+        elapsed += (time - previous) & 0xFFFF
+        previous = time
+        name = KINDS[kind]
+        if name == "BUTTON":
+            text = "%s %s" % (BUTTONS[data >> 1], "pressed" if data & 1 else "released")
+        elif name == "ENCODER_A":
+            pulses += data
+            text = "encoder A %+d -> %d" % (data, pulses)
+        elif name == "ENCODER_B":
+            text = "encoder B %+d" % data
+        elif name == "GLITCH":
+            text = "glitch rejected on encoder %s" % "AB"[data]
+        elif name == "ENDSTOP":
+            text = "end stop %s" % ("hit" if data else "released")
+        elif name == "STATE":
+            text = "-> %s" % STATES[data]
+        elif name == "MOTOR":
+            text = "motor %s" % ("stop" if data == 0 else "%s speed %d" % ("up" if data > 0 else "down", abs(data) * 8))
+        elif name == "COMMAND":
+            text = "serial command '%s'" % chr(data)
+        elif name == "CLOCK":
+            continue
+        elif name == "FRAME":
+            text = "display: %d full frame%s" % (data, "" if data == 1 else "s")
+        else:
+            text = "display: %d digit frame%s" % (data, "" if data == 1 else "s")
+        print("%9.3f  %s" % (elapsed / 1000.0, text))
+
+    end = "dump requested" if lost is None else "live trace stopped"
+    print("%9.3f  %s (%d entries)" % ((elapsed + ((end_time - previous) & 0xFFFF)) / 1000.0, end, len(entries)))
+    if lost:
+        print("%d live entries were lost: the timeline has gaps" % lost)
+
+
+if __name__ == "__main__":
+    main()
@@ -1,53 +1,77 @@
 #include "ButtonHandler.h"
 
-ButtonHandler::ButtonHandler(uint8_t pin)
-    : pin(pin), lastButtonState(HIGH), buttonState(HIGH), lastDebounceTime(0), lastPressTime(0) {}
+#include "TraceRecorder.h"
 
-void ButtonHandler::init() {
-  pinMode(pin, INPUT_PULLUP);
-}
+ButtonEdge ButtonHandler::queue[ButtonHandler::QUEUE_SIZE];
+volatile uint8_t ButtonHandler::queueHead = 0;
+volatile uint8_t ButtonHandler::queueTail = 0;
+volatile uint8_t ButtonHandler::droppedEdges = 0;
 
-void ButtonHandler::update() {
-  int reading = digitalRead(pin);
+ButtonHandler::ButtonHandler(uint8_t pin) : id(pin == DOWN_BUTTON_PIN ? 1 : 0) {}
 
-  if (reading != lastButtonState) {
-    lastDebounceTime = millis();
+void ButtonHandler::init() {
+  // The interrupt number doubles as button id
+  if (id == 0) {
+    UpPin::setInputPullup();
+    attachInterrupt(0, onInterrupt0, CHANGE);
+  } else {
+    DownPin::setInputPullup();
+    attachInterrupt(1, onInterrupt1, CHANGE);
   }
+}
 
-  if ((millis() - lastDebounceTime) > DEBOUNCE_DELAY) {
-    if (reading != buttonState) {
-      buttonState = reading;
-      if (buttonState == LOW) { // Button pressed (active low)
-        lastPressTime = millis();
-      }
-    }
-  }
+uint8_t ButtonHandler::getId() const {
+  return id;
+}
 
-  lastButtonState = reading;
+uint8_t ButtonHandler::getPin() const {
+  if (id == 0) {
+    return UP_BUTTON_PIN;
+  }
+  return DOWN_BUTTON_PIN;
 }
 
 bool ButtonHandler::isPressed() const {
-  return buttonState == LOW;
+  return id == 0 ? UpPin::isLow() : DownPin::isLow(); // Active low
 }
 
-bool ButtonHandler::isLongPressed() const {
-  return isPressed() && (millis() - lastPressTime) >= LONG_PRESS_TIME;
+void ButtonHandler::onInterrupt0() {
+  pushEdge(0, UpPin::isLow());
 }
 
-bool ButtonHandler::isVeryLongPressed() const {
-  return isPressed() && (millis() - lastPressTime) >= VERY_LONG_PRESS_TIME;
+void ButtonHandler::onInterrupt1() {
+  pushEdge(1, DownPin::isLow());
 }
 
-bool ButtonHandler::isBothPressed(const ButtonHandler& other) const {
-  return isPressed() && other.isPressed();
+void ButtonHandler::pushEdge(uint8_t id, bool pressed) {
+  TraceRecorder::record(TraceRecorder::BUTTON, static_cast<int8_t>((id << 1) | pressed));
+
+  uint8_t head = queueHead;
+  uint8_t next = (head + 1) & (QUEUE_SIZE - 1);
+  if (next == queueTail) {
+    // Consumer fell behind; the recognizer resyncs from the pin level
+    droppedEdges++;
+    return;
+  }
+
+  ButtonEdge& edge = queue[head];
+  edge.button = id;
+  edge.pressed = pressed;
+  edge.time = static_cast<uint16_t>(millis());
+  queueHead = next;
 }
 
-bool ButtonHandler::isBothLongPressed(const ButtonHandler& other) const {
-  return isBothPressed(other) && (millis() - lastPressTime) >= BOTH_BUTTONS_TIME &&
-         (millis() - other.lastPressTime) >= BOTH_BUTTONS_TIME;
+bool ButtonHandler::popEdge(ButtonEdge& edge) {
+  uint8_t tail = queueTail;
+  if (tail == queueHead) {
+    return false;
+  }
+  __asm__ __volatile__("" ::: "memory"); // Do not read the slot before checking queueHead
+  edge = queue[tail];
+  queueTail = (tail + 1) & (QUEUE_SIZE - 1);
+  return true;
 }
 
-bool ButtonHandler::isBothVeryLongPressed(const ButtonHandler& other) const {
-  return isBothPressed(other) && (millis() - lastPressTime) >= VERY_LONG_PRESS_TIME &&
-         (millis() - other.lastPressTime) >= VERY_LONG_PRESS_TIME;
+uint8_t ButtonHandler::getDroppedEdges() {
+  return droppedEdges;
 }
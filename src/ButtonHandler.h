@@ -3,29 +3,52 @@
 
 #include <Arduino.h>
 
+#include "FastPin.h"
+#include "Pins.h"
+
+// Raw, timestamped edge captured in the button ISR
+struct ButtonEdge {
+  uint8_t button; // ButtonHandler id (= external interrupt number)
+  bool pressed;
+  uint16_t time; // millis() truncated to 16 bits, compare with wrap-safe subtraction
+};
+
+// Push button on an external interrupt pin: UP_BUTTON_PIN on INT0 (D2) and
+// DOWN_BUTTON_PIN on INT1 (D3). Those pins are fixed in hardware and checked at
+// compile time, so the ISRs sample them with FastPin.
+//
+// Every edge is pushed by the ISR into a single shared ring buffer, so the
+// order between the two buttons is preserved. The ISR is the only producer and
+// popEdge() the only consumer; with 8-bit indices no locking is needed.
+// Debouncing and gesture detection happen in GestureRecognizer.
 class ButtonHandler {
 public:
-  ButtonHandler(uint8_t pin);
+  ButtonHandler(uint8_t pin); // UP_BUTTON_PIN or DOWN_BUTTON_PIN
   void init();
-  bool isPressed() const;
-  bool isLongPressed() const;
-  bool isVeryLongPressed() const;
-  bool isBothPressed(const ButtonHandler& other) const;
-  bool isBothLongPressed(const ButtonHandler& other) const;
-  bool isBothVeryLongPressed(const ButtonHandler& other) const;
-  void update();
+  uint8_t getId() const;
+  uint8_t getPin() const;
+  bool isPressed() const; // Raw pin level, not debounced
+
+  static bool popEdge(ButtonEdge& edge);
+  static uint8_t getDroppedEdges();
 
 private:
-  uint8_t pin;
-  bool lastButtonState;
-  bool buttonState;
-  unsigned long lastDebounceTime;
-  unsigned long lastPressTime;
-
-  static const unsigned long DEBOUNCE_DELAY = 50;         // milliseconds
-  static const unsigned long LONG_PRESS_TIME = 1000;      // milliseconds
-  static const unsigned long BOTH_BUTTONS_TIME = 2000;    // milliseconds for both buttons
-  static const unsigned long VERY_LONG_PRESS_TIME = 5000; // milliseconds
+  static_assert(UP_BUTTON_PIN == 2, "UP_BUTTON_PIN must be D2 (INT0)");
+  static_assert(DOWN_BUTTON_PIN == 3, "DOWN_BUTTON_PIN must be D3 (INT1)");
+  typedef FastPin<UP_BUTTON_PIN> UpPin;
+  typedef FastPin<DOWN_BUTTON_PIN> DownPin;
+
+  static void onInterrupt0();
+  static void onInterrupt1();
+  static void pushEdge(uint8_t id, bool pressed);
+
+  uint8_t id; // External interrupt number: 0 = up, 1 = down
+
+  static const uint8_t QUEUE_SIZE = 16; // Must be a power of two
+  static ButtonEdge queue[QUEUE_SIZE];
+  static volatile uint8_t queueHead; // Written by ISR
+  static volatile uint8_t queueTail; // Written by popEdge()
+  static volatile uint8_t droppedEdges;
 };
 
 #endif // BUTTONHANDLER_H
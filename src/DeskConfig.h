@@ -0,0 +1,42 @@
+#ifndef DESKCONFIG_H
+#define DESKCONFIG_H
+
+#include "DeskController.h"
+
+// Build configuration: the display and optional features the controller is
+// composed with. Everything defaults to on; build flags strip features:
+//   NO_DISPLAY          no OLED, screens compile to nothing (serial only)
+//   NO_PRESETS          no preset mode; the long chord goes to calibration
+//   NO_CALIBRATION_UI   no on-desk calibration, uses the table in EEPROM
+//   NO_CHARACTERIZATION no motor learning run ('m')
+//   NO_TRACE            no event trace ('t'), frees its 128-byte ring
+
+#ifdef NO_DISPLAY
+#include "NullDisplay.h"
+typedef NullDisplay DeskDisplay;
+#else
+#include "HeightDisplay.h"
+typedef HeightDisplay DeskDisplay;
+#endif
+
+struct DeskFeatures {
+#ifdef NO_PRESETS
+  static const bool PRESETS = false;
+#else
+  static const bool PRESETS = true;
+#endif
+#ifdef NO_CALIBRATION_UI
+  static const bool CALIBRATION = false;
+#else
+  static const bool CALIBRATION = true;
+#endif
+#ifdef NO_CHARACTERIZATION
+  static const bool CHARACTERIZATION = false;
+#else
+  static const bool CHARACTERIZATION = true;
+#endif
+};
+
+typedef DeskController<DeskDisplay, DeskFeatures> Desk;
+
+#endif // DESKCONFIG_H
@@ -1,287 +1,961 @@
 #include "DeskController.h"
 
-DeskController::DeskController(ButtonHandler& upButton, ButtonHandler& downButton, EndStop& endStop,
-                               OpticalEncoder& encoder, MotorControl& motor, HeightDisplay& display)
-    : upButton(upButton), downButton(downButton), endStop(endStop), encoder(encoder), motor(motor), display(display),
-      state() {}
+#include "DeskConfig.h"
 
-void DeskController::init() {
-  state.init();
+#include "MemoryMonitor.h"
+#include "TraceRecorder.h"
+#include "Watchdog.h"
+
+// Indexed by DeskState::State. Disabled features get an empty row.
+template <class Display, class Features>
+const typename DeskController<Display, Features>::StateHandlers
+    DeskController<Display, Features>::STATE_TABLE[] PROGMEM = {
+    // IDLE
+    {&DeskController::enterIdle, nullptr, &DeskController::updateIdle, &DeskController::handleIdleEvent,
+     &DeskController::drawHeight},
+    // MOVING_UP
+    {&DeskController::enterMoving, &DeskController::exitMoving, &DeskController::updateMoving,
+     &DeskController::handleMovingEvent, &DeskController::drawHeight},
+    // MOVING_DOWN
+    {&DeskController::enterMoving, &DeskController::exitMoving, &DeskController::updateMoving,
+     &DeskController::handleMovingEvent, &DeskController::drawHeight},
+    // CALIBRATING
+    Features::CALIBRATION
+        ? StateHandlers{&DeskController::enterCalibrating, nullptr, &DeskController::updateCalibrating,
+                        &DeskController::handleCalibrationEvent, &DeskController::drawCalibration}
+        : StateHandlers(),
+    // PRESET_MODE
+    Features::PRESETS ? StateHandlers{&DeskController::enterPresetMode, nullptr, &DeskController::updatePresetMode,
+                                      &DeskController::handlePresetEvent, &DeskController::drawPresetMode}
+                      : StateHandlers(),
+    // PRESET_EDIT_MODE (unused)
+    {nullptr, nullptr, nullptr, nullptr, nullptr},
+    // CHARACTERIZING
+#ifdef NO_CHARACTERIZATION
+    StateHandlers(),
+#else
+    Features::CHARACTERIZATION
+        ? StateHandlers{&DeskController::enterCharacterizing, &DeskController::exitCharacterizing,
+                        &DeskController::updateCharacterizing, &DeskController::handleCharacterizingEvent, nullptr}
+        : StateHandlers(),
+#endif
+};
+
+template <class Display, class Features>
+DeskController<Display, Features>::DeskController()
+    : upButton(UP_BUTTON_PIN), downButton(DOWN_BUTTON_PIN), endStop(), encoder(10.0f), motor(),
+#ifdef DUAL_LEG
+      encoderB(10.0f, 1), motorB(1), legSync(motor, encoder, motorB, encoderB), legsLevelling(false),
+#endif
+      display(),
+      state(), gestures(upButton, downButton),
+#ifndef NO_CHARACTERIZATION
+      characterizer(motor, encoder, endStop),
+#endif
+      stallDetector(), moveStats(),
+      stopReason(MoveStats::OTHER), lastLoopStart(0), power(),
+      lastActivity(0), dimmed(false), lastButtonPress(0), chordEnteredPresets(false), displayDirty(true),
+      shownHeight(0.0f), hasTarget(false), targetHeight(0.0f), endStopTriggered(false),
+      endStopDirection(0), coastPending(false),
+      coastUp(false), coastSpeed(0), coastStartHeight(0.0f), calStep(CAL_POINT), calStepStart(0),
+      calAdjusting(false), calDrive(0), calHeight(700.0f), calPoints(0) {}
+
+template <class Display, class Features>
+void DeskController<Display, Features>::init() {
+  // Staged startup: motor, position and end stop first so the desk can be driven
+  // from the first loop; the display is brought up and painted from update()
   motor.init();
-  display.init();
+  upButton.init();
+  downButton.init();
+  endStop.init();
+  encoder.init();
+#ifdef DUAL_LEG
+  legSync.init();
+#endif
+  state.init();
   
-  // Configure encoder from saved settings
+  // Configure encoder and motor from saved settings
   encoder.setSlitsPerMM(state.getEncoderSlitsPerMM());
+  HeightTable table;
+  state.loadHeightTable(table);
+  encoder.setHeightTable(table);
+  encoder.setPulseCount(state.getPulseCount());
+#ifdef DUAL_LEG
+  legSync.align();
+#endif
+  state.updateHeight(encoder.getHeightMM());
+  state.loadMotorProfile(motor.getProfile());
+  endStopTriggered = endStop.isTriggered();
+  if (endStopTriggered) {
+    // Booted on the switch: the restored height says which end, without it both ways are blocked
+    endStopDirection = ENDSTOP_BOTH;
+    if (state.isCalibrated()) {
+      const SpeedZones& zones = state.getSpeedZones();
+      endStopDirection = state.getCurrentHeight() > (zones.minHeight + zones.maxHeight) / 2 ? 1 : -1;
+    }
+  }
+
+  display.init();
+
+  // Buttons and encoder wake the MCU from idle sleep
+  power.addWakePin(upButton.getPin());
+  power.addWakePin(downButton.getPin());
+  power.addWakePin(encoder.getPin());
+
+  state.setState(DeskState::IDLE);
+  enterIdle();
 
   if (!state.isCalibrated()) {
     display.showStatusMessage("Please calibrate", false);
   }
+  reportResetCause();
+
+  Watchdog::arm();
+
+  Serial.print(F("Ready in "));
+  Serial.print(millis());
+  Serial.println(F(" ms"));
 }
 
-void DeskController::update() {
-  upButton.update();
-  downButton.update();
+template <class Display, class Features>
+void DeskController<Display, Features>::reportResetCause() {
+  uint8_t flags = Watchdog::getResetFlags();
+  ResetLog log;
+  state.loadResetLog(log);
+  log.lastFlags = flags;
+  if (flags & _BV(WDRF)) {
+    log.watchdogResets++;
+    log.lastState = Watchdog::getLastContext();
+  }
+  state.saveResetLog(log);
+
+  Serial.print(F("Reset: 0x"));
+  Serial.print(flags, HEX);
+  if (flags & _BV(WDRF)) {
+    Serial.print(F(" watchdog in state "));
+    Serial.print(log.lastState);
+    display.showStatusMessage("Watchdog reset", false);
+  } else if (flags & _BV(BORF)) {
+    Serial.print(F(" brown-out"));
+  }
+  Serial.print(F(", watchdog resets: "));
+  Serial.println(log.watchdogResets);
+}
+
+template <class Display, class Features>
+void DeskController<Display, Features>::update() {
+  unsigned long loopStart = millis();
+  unsigned long loopTime = loopStart - lastLoopStart;
+  lastLoopStart = loopStart;
+
   encoder.update();
+  bool triggered = endStop.isTriggered();
+  if (triggered != endStopTriggered) {
+    TraceRecorder::record(TraceRecorder::ENDSTOP, triggered);
+    endStopTriggered = triggered;
+    // Driven or coasting, the desk ran into the switch the way the encoder is counting
+    endStopDirection = triggered ? encoder.getDirection() : 0;
+  }
   motor.update();
+#ifdef DUAL_LEG
+  DeskState::State current = state.getState();
+  LegSync::Status legs = legSync.update();
+  bool driving = current == DeskState::MOVING_UP || current == DeskState::MOVING_DOWN ||
+                 current == DeskState::CHARACTERIZING || (current == DeskState::CALIBRATING && calDrive != 0);
+  if (legs == LegSyncLogic::FAULT && driving) {
+    // Both legs are already stopped; the next move levels the desk
+    stopReason = MoveStats::FAULT;
+    transitionTo(DeskState::IDLE);
+    Serial.print(F("Legs out of sync: "));
+    Serial.println(legSync.getSkewMM());
+    display.showStatusMessage("Leg skew", false);
+  } else if (legsLevelling && legs == LegSyncLogic::IN_SYNC) {
+    Serial.println(F("Legs level"));
+    display.showStatusMessage("Legs level", true);
+  }
+  legsLevelling = legs == LegSyncLogic::LEVELLING;
+#endif
   display.update(); // Update display animations
+  state.updateHeight(encoder.getInterpolatedHeightMM());
+  moveStats.update(state.getCurrentHeight(), loopTime > 255 ? 255 : static_cast<uint8_t>(loopTime));
 
-  handleButtons();
-  handleMovement();
-  handleCalibration();
-  handlePresetMode();
-  updateDisplay();
-}
-
-void DeskController::handleButtons() {
-  // Simple button state detection
-  bool upPressed = upButton.isPressed();
-  bool downPressed = downButton.isPressed();
-  bool bothPressed = upPressed && downPressed;
-  bool downLong = downButton.isLongPressed();
-  bool bothLong = upButton.isBothLongPressed(downButton);
-  bool bothVeryLong = upButton.isBothVeryLongPressed(downButton);
-  
-  switch (state.getState()) {
-    case DeskState::IDLE:
-      handleIdleButtons(upPressed, downPressed, downLong, bothLong, bothVeryLong);
-      break;
-      
-    case DeskState::PRESET_MODE:
-      handlePresetButtons(upPressed, downPressed, bothPressed, bothLong);
-      break;
-      
-    default:
-      // For all other states, return to IDLE when no buttons pressed
-      if (!upPressed && !downPressed && state.getState() != DeskState::CALIBRATING) {
-        state.setState(DeskState::IDLE);
-      }
-      break;
+  gestures.update();
+  StateHandlers handlers;
+  ButtonEvent event;
+  while (gestures.poll(event)) {
+    wake();
+    loadHandlers(state.getState(), handlers);
+    if (handlers.event) {
+      (this->*handlers.event)(event);
+    }
+  }
+
+  loadHandlers(state.getState(), handlers);
+  if (handlers.update) {
+    (this->*handlers.update)();
+  }
+
+  if (display.consumeRedrawRequest()) {
+    loadHandlers(state.getState(), handlers);
+    if (handlers.draw) {
+      (this->*handlers.draw)();
+    }
   }
+
+  handleSerial();
+  TraceRecorder::dumpStep(Serial);
+  moveStats.dumpStep(Serial);
+  updatePowerSaving();
+
+  Watchdog::feed();
 }
 
-void DeskController::handleIdleButtons(bool up, bool down, bool downLong, bool bothLong, bool bothVeryLong) {
-  if (bothVeryLong) {
-    // Priority 1: Both buttons very long press -> Full Calibration (encoder + height)
-    state.setState(DeskState::CALIBRATING);
-    display.showStatusMessage("Entering Calibration", true);
-  } else if (bothLong) {
-    // Priority 2: Both buttons long press -> Preset mode
-    state.setState(DeskState::PRESET_MODE);
-    display.showStatusMessage("Entering Presets", true);
-  } else if (down && downLong && !state.isCalibrated()) {
-    // Priority 3: Down long press when uncalibrated -> Calibration
-    state.setState(DeskState::CALIBRATING);
-  } else if (up && !down) {
-    // Priority 4: Up button alone -> Move up
-    state.setState(DeskState::MOVING_UP);
-  } else if (down && !up) {
-    // Priority 5: Down button alone -> Move down
-    state.setState(DeskState::MOVING_DOWN);
+template <class Display, class Features>
+void DeskController<Display, Features>::loadHandlers(DeskState::State s, StateHandlers& handlers) {
+  memcpy_P(&handlers, &STATE_TABLE[s], sizeof(StateHandlers));
+}
+
+template <class Display, class Features>
+void DeskController<Display, Features>::transitionTo(DeskState::State next) {
+  StateHandlers handlers;
+  loadHandlers(state.getState(), handlers);
+  if (handlers.exit) {
+    (this->*handlers.exit)();
+  }
+
+  state.setState(next);
+  Watchdog::setContext(next);
+  TraceRecorder::record(TraceRecorder::STATE, next);
+  wake();
+
+  loadHandlers(next, handlers);
+  if (handlers.enter) {
+    (this->*handlers.enter)();
   }
 }
 
-void DeskController::handlePresetButtons(bool up, bool down, bool both, bool bothLong) {
-  static unsigned long lastButtonPress = 0;
-  
-  if (bothLong) {
-    // Save current preset
-    saveCurrentPreset();
-    state.setState(DeskState::IDLE);
-    char message[20];
-    snprintf(message, sizeof(message), "Preset %d Saved", state.getCurrentPreset() + 1);
-    display.showStatusMessage(message, true);
-  } else if (both && !bothLong) {
-    // Go to current preset
-    moveToPreset(state.getCurrentPreset());
-  } else if (up && !down) {
-    // Cycle preset forward
-    state.cyclePreset(true);
-    lastButtonPress = millis();
-  } else if (down && !up) {
-    // Cycle preset backward
-    state.cyclePreset(false);
-    lastButtonPress = millis();
-  } else if (!up && !down) {
-    // No buttons - check timeout
-    if (lastButtonPress == 0) {
-      lastButtonPress = millis();
-    } else if (millis() - lastButtonPress > PRESET_TIMEOUT) {
-      state.setState(DeskState::IDLE);
-      display.showStatusMessage("Normal Mode", true);
-      lastButtonPress = 0;
+// --- IDLE -------------------------------------------------------------------
+
+template <class Display, class Features>
+void DeskController<Display, Features>::enterIdle() {
+  motor.stop();
+  hasTarget = false;
+  displayDirty = true;
+  refreshHeight(false);
+}
+
+template <class Display, class Features>
+void DeskController<Display, Features>::updateIdle() {
+  float height = state.getCurrentHeight();
+
+  // Once the desk has coasted to a stop, learn the stop distance and persist the final position
+  if (coastPending && !encoder.isMoving()) {
+    coastPending = false;
+    if (coastSpeed > 0) {
+      state.learnStopDistance(coastUp, coastSpeed, coastUp ? height - coastStartHeight : coastStartHeight - height);
+    }
+    state.setPulseCount(encoder.getPulseCount());
+    state.saveToEEPROM();
+    moveStats.finish(height);
+  }
+
+  refreshHeight(false);
+}
+
+template <class Display, class Features>
+void DeskController<Display, Features>::drawHeight() {
+  DeskState::State current = state.getState();
+  displayDirty = true;
+  refreshHeight(current == DeskState::MOVING_UP || current == DeskState::MOVING_DOWN);
+}
+
+template <class Display, class Features>
+void DeskController<Display, Features>::handleIdleEvent(const ButtonEvent& event) {
+  switch (event.type) {
+  case ButtonEvent::CHORD_LONG:
+    // Both buttons long press -> Preset mode (keep holding for calibration)
+    if (Features::PRESETS) {
+      chordEnteredPresets = true;
+      transitionTo(DeskState::PRESET_MODE);
+    }
+    break;
+
+  case ButtonEvent::CHORD_VERY_LONG:
+    // Without preset mode the long chord goes straight to calibration
+    if (!Features::PRESETS && Features::CALIBRATION) {
+      transitionTo(DeskState::CALIBRATING);
     }
+    break;
+
+  case ButtonEvent::PRESS:
+    // Single button -> Move (chords never get here, so no false start)
+    transitionTo(event.button == ButtonEvent::UP ? DeskState::MOVING_UP : DeskState::MOVING_DOWN);
+    break;
+
+  default:
+    break;
+  }
+}
+
+// --- MOVING_UP / MOVING_DOWN -------------------------------------------------
+
+template <class Display, class Features>
+void DeskController<Display, Features>::enterMoving() {
+  bool up = state.getState() == DeskState::MOVING_UP;
+  uint8_t speed = driveSpeed(up);
+
+  coastPending = false;
+  stallDetector.reset();
+  moveStats.begin(state.getCurrentHeight(), hasTarget, targetHeight);
+  stopReason = MoveStats::OTHER;
+  encoder.setDirection(up ? 1 : -1);
+  if (up) {
+    motor.forward(speed);
   } else {
-    lastButtonPress = millis();
+    motor.backward(speed);
   }
+  displayDirty = true;
+}
+
+template <class Display, class Features>
+void DeskController<Display, Features>::exitMoving() {
+  // Motor is cut here: start measuring how far the desk coasts
+  beginCoast(state.getCurrentHeight());
+  moveStats.endDrive(stopReason, state.getCurrentHeight());
+  motor.stop();
+  hasTarget = false;
 }
 
-void DeskController::handleMovement() {
-  float currentHeight = encoder.getHeightMM();
-  state.updateHeight(currentHeight);
+template <class Display, class Features>
+void DeskController<Display, Features>::updateMoving() {
+  bool up = state.getState() == DeskState::MOVING_UP;
+  float height = state.getCurrentHeight();
+
+  if (driveBlocked(up)) {
+    transitionTo(DeskState::IDLE);
+    reportDriveStop();
+    return;
+  }
+
+  if (up ? height >= brakePoint(true) : height <= brakePoint(false)) {
+    stopReason = hasTarget ? MoveStats::TARGET : MoveStats::LIMIT;
+    transitionTo(DeskState::IDLE);
+    return;
+  }
 
-  switch (state.getState()) {
-  case DeskState::MOVING_UP:
-    motor.forward(MOTOR_SPEED);
+  motor.setSpeed(driveSpeed(up)); // Slow down on entering a zone near the limit
+  refreshHeight(true);
+}
+
+template <class Display, class Features>
+void DeskController<Display, Features>::handleMovingEvent(const ButtonEvent& event) {
+  if (hasTarget) {
+    // Preset move runs on its own; any new press cancels it
+    if (event.type == ButtonEvent::PRESS || event.type == ButtonEvent::CHORD) {
+      stopReason = MoveStats::CANCELLED;
+      transitionTo(DeskState::IDLE);
+    }
+    return;
+  }
+
+  switch (event.type) {
+  case ButtonEvent::RELEASE:
+  case ButtonEvent::CHORD:
+    stopReason = MoveStats::RELEASED;
+    transitionTo(DeskState::IDLE);
     break;
 
-  case DeskState::MOVING_DOWN:
-    motor.backward(MOTOR_SPEED);
+  case ButtonEvent::LONG:
+    // Down long press when uncalibrated -> Calibration
+    if (Features::CALIBRATION && event.button == ButtonEvent::DOWN && !state.isCalibrated()) {
+      transitionTo(DeskState::CALIBRATING);
+    }
     break;
 
-  case DeskState::IDLE:
-    motor.stop();
+  default:
     break;
+  }
+}
 
-  case DeskState::CALIBRATING:
-    // Handled in handleCalibration()
-    motor.stop();
+template <class Display, class Features>
+bool DeskController<Display, Features>::driveBlocked(bool up) {
+  // End stop blocks the direction that hit it until it is released
+  int8_t direction = up ? 1 : -1;
+  if (endStopTriggered && (endStopDirection == direction || endStopDirection == ENDSTOP_BOTH)) {
+    stopReason = MoveStats::ENDSTOP;
+    return true;
+  }
+
+  bool stalled = stallDetector.update(motor.getSpeed(), encoder.getPulseCount());
+#ifdef DUAL_LEG
+  if (legsLevelling) {
+    // Leg A may be held on purpose; LegSync watches the levelling leg's progress
+    stallDetector.reset();
+    stalled = false;
+  }
+#endif
+  if (stalled) {
+    stopReason = MoveStats::STALL;
+    return true;
+  }
+  return false;
+}
+
+template <class Display, class Features>
+void DeskController<Display, Features>::reportDriveStop() {
+  if (stopReason == MoveStats::ENDSTOP) {
+    display.showStatusMessage("End Stop", false);
+    return;
+  }
+  Serial.print(F("Stall #"));
+  Serial.print(stallDetector.getStallCount());
+  Serial.print(F(" at "));
+  Serial.println(state.getCurrentHeight());
+  display.showStatusMessage("Obstacle!", false);
+}
+
+template <class Display, class Features>
+float DeskController<Display, Features>::brakePoint(bool up) const {
+  // Cut the motor one learned stopping distance before the target or soft limit
+  float stopDistance = state.getStopDistance(up, motor.getSpeed());
+
+  const SpeedZones& zones = state.getSpeedZones();
+  if (up) {
+    float limit = state.isCalibrated() ? zones.maxHeight : 1e9f;
+    if (hasTarget && targetHeight < limit) {
+      limit = targetHeight;
+    }
+    return limit - stopDistance;
+  }
+
+  float limit = state.isCalibrated() ? zones.minHeight : -1e9f;
+  if (hasTarget && targetHeight > limit) {
+    limit = targetHeight;
+  }
+  return limit + stopDistance;
+}
+
+template <class Display, class Features>
+uint8_t DeskController<Display, Features>::driveSpeed(bool up) const {
+  // Without calibration the limits are unknown, so stay at a moderate speed
+  if (!state.isCalibrated()) {
+    return UNCALIBRATED_SPEED;
+  }
+  uint8_t speed = state.getZoneSpeed(up, state.getCurrentHeight());
+  if (hasTarget && speed > PRESET_MOVE_SPEED) {
+    speed = PRESET_MOVE_SPEED;
+  }
+  return speed;
+}
+
+template <class Display, class Features>
+void DeskController<Display, Features>::beginCoast(float height) {
+  // Only a free coast says how far the desk runs on: a stall, end stop, cancel or
+  // leg fault is stopped short and would teach a stop distance near 0 mm
+  bool freeCoast = stopReason == MoveStats::RELEASED || stopReason == MoveStats::TARGET ||
+                   stopReason == MoveStats::LIMIT;
+  coastSpeed = freeCoast ? motor.getSpeed() : 0; // 0: position is still saved, nothing is learned
+  coastPending = true;
+  coastUp = encoder.getDirection() > 0;
+  coastStartHeight = height;
+}
+
+// --- PRESET_MODE ------------------------------------------------------------
+
+template <class Display, class Features>
+void DeskController<Display, Features>::enterPresetMode() {
+  lastButtonPress = millis();
+  drawPresetMode();
+}
+
+template <class Display, class Features>
+void DeskController<Display, Features>::drawPresetMode() {
+  display.showPresetMode(state.getCurrentPreset() + 1, state.getPreset(state.getCurrentPreset()));
+}
+
+template <class Display, class Features>
+void DeskController<Display, Features>::updatePresetMode() {
+  if (millis() - lastButtonPress > PRESET_TIMEOUT) {
+    transitionTo(DeskState::IDLE);
+    display.showStatusMessage("Normal Mode", true);
+  }
+}
+
+template <class Display, class Features>
+void DeskController<Display, Features>::handlePresetEvent(const ButtonEvent& event) {
+  lastButtonPress = millis();
+
+  switch (event.type) {
+  case ButtonEvent::PRESS:
+  case ButtonEvent::REPEAT:
+    // Cycle presets
+    state.cyclePreset(event.button == ButtonEvent::UP);
+    drawPresetMode();
     break;
 
-  case DeskState::PRESET_MODE:
-    motor.stop();
+  case ButtonEvent::CHORD_TAP:
+    // Go to current preset
+    moveToPreset(state.getCurrentPreset());
     break;
 
-  case DeskState::PRESET_EDIT_MODE:
-    motor.stop();
+  case ButtonEvent::CHORD_LONG: {
+    // Save current preset
+    saveCurrentPreset();
+    transitionTo(DeskState::IDLE);
+    char message[20];
+    snprintf(message, sizeof(message), "Preset %d Saved", state.getCurrentPreset() + 1);
+    display.showStatusMessage(message, true);
+    break;
+  }
+
+  case ButtonEvent::CHORD_VERY_LONG:
+    // Same chord that opened preset mode still held -> Full Calibration (encoder + height)
+    if (Features::CALIBRATION && chordEnteredPresets) {
+      transitionTo(DeskState::CALIBRATING);
+    }
+    break;
+
+  case ButtonEvent::CHORD_RELEASE:
+    chordEnteredPresets = false;
+    break;
+
+  default:
     break;
   }
 }
 
-void DeskController::handleCalibration() {
-  if (state.getState() == DeskState::CALIBRATING) {
-    static uint8_t step = 0; // 0=start height, 1=end height, 2=results
-    static float startHeight = 700.0f; // Default start height
-    static float endHeight = 800.0f;   // Default end height 
-    static long startPulseCount = 0;
-    static bool initialized = false;
-    
-    // Initialize on first entry
-    if (!initialized) {
-      step = 0;
-      // Load current settings if they exist, otherwise use defaults
-      float currentSlitsPerMM = state.getEncoderSlitsPerMM();
-      if (currentSlitsPerMM > 0.1f && state.isCalibrated()) {
-        // Has existing calibration - use current height as start
-        startHeight = state.getCurrentHeight();
-      } else {
-        // No calibration - use default
-        startHeight = 700.0f;
-      }
-      endHeight = startHeight + 100.0f;
-      initialized = true;
+template <class Display, class Features>
+void DeskController<Display, Features>::moveToPreset(uint8_t presetIndex) {
+  float target = state.getPreset(presetIndex);
+  float currentHeight = state.getCurrentHeight();
+
+  // updateMoving() drives towards the target and brakes using the learned stop distance
+  hasTarget = true;
+  targetHeight = target;
+
+  if (target > currentHeight + TARGET_TOLERANCE) {
+    transitionTo(DeskState::MOVING_UP);
+  } else if (target < currentHeight - TARGET_TOLERANCE) {
+    transitionTo(DeskState::MOVING_DOWN);
+  } else {
+    hasTarget = false;
+  }
+}
+
+template <class Display, class Features>
+void DeskController<Display, Features>::saveCurrentPreset() {
+  state.savePreset(state.getCurrentPreset(), state.getCurrentHeight());
+}
+
+// --- CALIBRATING ------------------------------------------------------------
+
+template <class Display, class Features>
+void DeskController<Display, Features>::enterCalibrating() {
+  calStep = CAL_POINT;
+  calStepStart = millis();
+  calAdjusting = false;
+  calDrive = 0;
+  calPoints = 0;
+
+  // Start from the current height if calibrated, otherwise a default
+  calHeight = state.isCalibrated() ? state.getCurrentHeight() : 700.0f;
+
+  drawCalibration();
+}
+
+template <class Display, class Features>
+void DeskController<Display, Features>::updateCalibrating() {
+  if (calDrive != 0 && driveBlocked(calDrive > 0)) {
+    stopCalibrationDrive();
+    reportDriveStop();
+  }
+
+  // Results stay up for CAL_RESULT_MS, then back to normal operation
+  if (calStep == CAL_RESULT && millis() - calStepStart >= CAL_RESULT_MS) {
+    transitionTo(DeskState::IDLE);
+    display.showStatusMessage("Calibrated!", true);
+  }
+}
+
+template <class Display, class Features>
+void DeskController<Display, Features>::drawCalibration() {
+  if (calStep == CAL_RESULT) {
+    display.showEncoderCalibrationMode(calPoints, 0.0f, true, state.getEncoderSlitsPerMM());
+  } else if (calStep == CAL_MOVE) {
+    display.showCalibrationMove(calPoints + 1);
+  } else {
+    display.showEncoderCalibrationMode(calPoints + 1, calHeight, false);
+  }
+}
+
+template <class Display, class Features>
+void DeskController<Display, Features>::handleCalibrationEvent(const ButtonEvent& event) {
+  if (calStep == CAL_RESULT) {
+    return;
+  }
+
+  // Only auto-repeat presses that started in calibration, not the one that entered it
+  if (event.type == ButtonEvent::PRESS) {
+    calAdjusting = true;
+  } else if (event.type == ButtonEvent::RELEASE || event.type == ButtonEvent::CHORD) {
+    calAdjusting = false;
+  }
+
+  switch (event.type) {
+  case ButtonEvent::PRESS:
+  case ButtonEvent::REPEAT:
+    if (!calAdjusting) {
+      return;
     }
-    
-    // Show current step
-    long currentPulseCount = encoder.getPulseCount();
-    display.showEncoderCalibrationMode(step, startHeight, endHeight, currentPulseCount - startPulseCount);
-    
-    if (step == 0) {
-      // Step 1: Set start height
-      if (upButton.isPressed() && !downButton.isPressed()) {
-        startHeight += 1.0f;
-        if (startHeight > 1200.0f) startHeight = 1200.0f;
-      } else if (downButton.isPressed() && !upButton.isPressed()) {
-        startHeight -= 1.0f;
-        if (startHeight < 600.0f) startHeight = 600.0f;
-      } else if (upButton.isBothPressed(downButton) && !upButton.isLongPressed()) {
-        // Record start position and move to next step
-        startPulseCount = encoder.getPulseCount();
-        step = 1;
-        endHeight = startHeight + 100.0f; // Default 100mm difference
-      }
-      
-    } else if (step == 1) {
-      // Step 2: Set end height (after moving desk)
-      if (upButton.isPressed() && !downButton.isPressed()) {
-        endHeight += 1.0f;
-        if (endHeight > 1200.0f) endHeight = 1200.0f;
-      } else if (downButton.isPressed() && !upButton.isPressed()) {
-        endHeight -= 1.0f;
-        if (endHeight < 600.0f) endHeight = 600.0f;
-      } else if (upButton.isBothPressed(downButton) && !upButton.isLongPressed()) {
-        // Calculate and save slits per mm + set height offset
-        long totalPulses = currentPulseCount - startPulseCount;
-        float heightDiff = endHeight - startHeight;
-        
-        if (heightDiff != 0 && totalPulses != 0) {
-          float slitsPerMM = abs(totalPulses) / abs(heightDiff);
-          state.setEncoderSlitsPerMM(slitsPerMM);
-          encoder.setSlitsPerMM(slitsPerMM);
-          
-          // Set height offset so current position shows as startHeight
-          float currentEncoderHeight = encoder.getHeightMM();
-          float heightOffset = startHeight - currentEncoderHeight;
-          state.setHeightOffset(heightOffset);
-          
-          state.setCalibrated(true);
-          step = 2;
-          
-          // Show results for 2 seconds then exit
-          delay(2000);
-          state.setState(DeskState::IDLE);
-          display.showStatusMessage("Calibrated!", true);
-          delay(1500);
-        }
-        
-        // Reset for next time
-        initialized = false;
-        step = 0;
+    if (calStep == CAL_MOVE) {
+      // Hold to drive, so the encoder is told which way the desk travels
+      if (event.type == ButtonEvent::PRESS) {
+        startCalibrationDrive(event.button == ButtonEvent::UP);
       }
+      return;
+    }
+    if (event.button == ButtonEvent::UP) {
+      calHeight += 1.0f;
+      if (calHeight > 1200.0f) calHeight = 1200.0f;
+    } else {
+      calHeight -= 1.0f;
+      if (calHeight < 600.0f) calHeight = 600.0f;
+    }
+    break;
+
+  case ButtonEvent::RELEASE:
+  case ButtonEvent::CHORD:
+    stopCalibrationDrive();
+    return;
+
+  case ButtonEvent::CHORD_TAP:
+    if (calStep == CAL_MOVE) {
+      // At the next position: start the height from the travel at the current scale
+      float travel = (encoder.getPulseCount() - calPulses[calPoints - 1]) / encoder.getSlitsPerMM();
+      calHeight = static_cast<float>(calHeights[calPoints - 1]) / HeightTable::HEIGHT_SCALE + travel;
+      if (calHeight > 1200.0f) calHeight = 1200.0f;
+      if (calHeight < 600.0f) calHeight = 600.0f;
+      calStep = CAL_POINT;
+      break;
     }
+    // Record this position as a reference point, then drive the desk to the next one
+    calPulses[calPoints] = encoder.getPulseCount();
+    calHeights[calPoints] = static_cast<int16_t>(calHeight * HeightTable::HEIGHT_SCALE + 0.5f);
+    calPoints++;
+    if (calPoints == MAX_CAL_POINTS) {
+      finishCalibration();
+      return;
+    }
+    calStep = CAL_MOVE;
+    break;
+
+  case ButtonEvent::CHORD_LONG:
+    // Done recording points
+    finishCalibration();
+    return;
+
+  default:
+    return;
   }
+
+  drawCalibration();
 }
 
-void DeskController::handlePresetMode() {
-  if (state.getState() == DeskState::PRESET_MODE) {
-    // Check if we should save the current preset
-    if (upButton.isBothLongPressed(downButton)) {
-      saveCurrentPreset();
-      char message[20];
-      snprintf(message, sizeof(message), "Preset %d Saved", state.getCurrentPreset() + 1);
-      display.showStatusMessage(message, true);
-    }
+template <class Display, class Features>
+void DeskController<Display, Features>::startCalibrationDrive(bool up) {
+  calDrive = up ? 1 : -1;
+  stallDetector.reset();
+  encoder.setDirection(calDrive);
+  if (up) {
+    motor.forward(CAL_DRIVE_SPEED);
+  } else {
+    motor.backward(CAL_DRIVE_SPEED);
   }
 }
 
-void DeskController::moveToPreset(uint8_t presetIndex) {
-  float targetHeight = state.getPreset(presetIndex);
-  float currentHeight = state.getCurrentHeight();
+template <class Display, class Features>
+void DeskController<Display, Features>::stopCalibrationDrive() {
+  // The encoder keeps its direction, so the coast is still counted the right way
+  motor.stop();
+  calDrive = 0;
+}
 
-  if (targetHeight > currentHeight) {
-    state.setState(DeskState::MOVING_UP);
-    motor.forward(PRESET_MOVE_SPEED);
-  } else if (targetHeight < currentHeight) {
-    state.setState(DeskState::MOVING_DOWN);
-    motor.backward(PRESET_MOVE_SPEED);
+template <class Display, class Features>
+void DeskController<Display, Features>::finishCalibration() {
+  HeightTable table;
+  if (!OpticalEncoder::buildHeightTable(table, calPulses, calHeights, calPoints) ||
+      calHeights[0] == calHeights[calPoints - 1]) {
+    transitionTo(DeskState::IDLE);
+    display.showStatusMessage("Cal Failed", false);
+    return;
   }
 
-  // The movement will be stopped by handleMovement() when we reach the target
+  // Up to ~57 EEPROM bytes in this tick: feed around each write so none runs into the deadline
+  encoder.setHeightTable(table);
+  Watchdog::feed();
+  state.saveHeightTable(table);
+  Watchdog::feed();
+
+  // Average scale over the whole calibrated span, for code that needs slits per mm
+  long totalPulses = calPulses[calPoints - 1] - calPulses[0];
+  float heightDiff = static_cast<float>(calHeights[calPoints - 1] - calHeights[0]) / HeightTable::HEIGHT_SCALE;
+  float slitsPerMM = abs(totalPulses) / abs(heightDiff);
+  state.setEncoderSlitsPerMM(slitsPerMM);
+  encoder.setSlitsPerMM(slitsPerMM);
+
+  // The table gives absolute heights
+  state.setHeightOffset(0.0f);
+  state.setPulseCount(encoder.getPulseCount());
+  state.setCalibrated(true);
+  Watchdog::feed();
+
+  // Show results; updateCalibrating() returns to IDLE after CAL_RESULT_MS
+  calStep = CAL_RESULT;
+  calStepStart = millis();
+  drawCalibration();
 }
 
-void DeskController::saveCurrentPreset() {
-  state.savePreset(state.getCurrentPreset(), state.getCurrentHeight());
+// --- CHARACTERIZING ---------------------------------------------------------
+
+#ifndef NO_CHARACTERIZATION
+template <class Display, class Features>
+void DeskController<Display, Features>::enterCharacterizing() {
+  characterizer.start();
+  display.showStatusMessage("Motor Test", true);
+}
+
+template <class Display, class Features>
+void DeskController<Display, Features>::exitCharacterizing() {
+  if (characterizer.isActive()) {
+    // Left early: restore the last good profile
+    characterizer.abort();
+    state.loadMotorProfile(motor.getProfile());
+  }
+
+  // The sweeps moved the desk: save where it settles, but learn no stop distance
+  stopReason = MoveStats::OTHER;
+  beginCoast(state.getCurrentHeight());
 }
 
-void DeskController::updateDisplay() {
+template <class Display, class Features>
+void DeskController<Display, Features>::updateCharacterizing() {
+  // The sweeps drive blind: on a calibrated desk the soft limits still hold
   if (state.isCalibrated()) {
-    switch (state.getState()) {
-      case DeskState::PRESET_MODE:
-        display.showPresetMode(state.getCurrentPreset() + 1, state.getPreset(state.getCurrentPreset()));
-        break;
-      
-      case DeskState::CALIBRATING:
-        // Handled separately in handleCalibration()
-        break;
-        
-      case DeskState::MOVING_UP:
-      case DeskState::MOVING_DOWN:
-        display.showHeight(state.getCurrentHeight(), true);
-        break;
-        
-      default:
-        display.showHeight(state.getCurrentHeight(), false);
-        break;
+    const SpeedZones& zones = state.getSpeedZones();
+    float height = state.getCurrentHeight();
+    if (height < zones.minHeight || height > zones.maxHeight) {
+      transitionTo(DeskState::IDLE);
+      Serial.println(F("Motor characterisation stopped at a soft limit"));
+      display.showStatusMessage("Limit Reached", false);
+      return;
     }
   }
+
+  MotorCharacterizer::Result result = characterizer.update();
+  if (result == MotorCharacterizer::RUNNING) {
+    return;
+  }
+
+  transitionTo(DeskState::IDLE);
+  if (result == MotorCharacterizer::DONE) {
+    const MotorProfile& profile = motor.getProfile();
+    Watchdog::feed(); // 37 bytes after the idle screen was drawn
+    state.saveMotorProfile(profile);
+    Serial.print(F("Motor deadband up/down: "));
+    Serial.print(profile.forwardDuty[0]);
+    Serial.print('/');
+    Serial.println(profile.backwardDuty[0]);
+    display.showStatusMessage("Motor Learned", true);
+  } else {
+    // Restore the last good profile
+    state.loadMotorProfile(motor.getProfile());
+    Serial.println(F("Motor characterisation failed"));
+    display.showStatusMessage("Motor Failed", false);
+  }
+}
+
+template <class Display, class Features>
+void DeskController<Display, Features>::handleCharacterizingEvent(const ButtonEvent& event) {
+  // Any button aborts the sweep
+  if (event.type == ButtonEvent::PRESS || event.type == ButtonEvent::CHORD) {
+    transitionTo(DeskState::IDLE);
+    display.showStatusMessage("Aborted", false);
+  }
+}
+#endif
+
+// --- Shared -----------------------------------------------------------------
+
+template <class Display, class Features>
+void DeskController<Display, Features>::refreshHeight(bool moving) {
+  if (!state.isCalibrated()) {
+    return;
+  }
+
+  float height = state.getCurrentHeight();
+  if (!displayDirty && fabs(height - shownHeight) < 0.05f) {
+    return;
+  }
+
+  display.showHeight(height, moving ? motor.getDirection() : 0);
+  shownHeight = height;
+  displayDirty = false;
+}
+
+template <class Display, class Features>
+void DeskController<Display, Features>::updatePowerSaving() {
+  if (state.getState() != DeskState::IDLE || coastPending || encoder.isMoving()) {
+    wake();
+    return;
+  }
+
+  unsigned long idleTime = millis() - lastActivity;
+  if (idleTime >= SLEEP_AFTER_MS) {
+    display.setPanelOn(false);
+    Watchdog::disarm(); // Would reset us out of power-down
+    power.sleep();
+    Watchdog::arm();
+
+    // Woken by a button or the desk being moved by hand. The press is picked up
+    // by the gesture recognizer on the next tick; just get the screen back.
+    // INT0/INT1 missed the waking edge, so trace the buttons held for a replay.
+    if (upButton.isPressed()) {
+      TraceRecorder::record(TraceRecorder::BUTTON, static_cast<int8_t>((upButton.getId() << 1) | 1));
+    }
+    if (downButton.isPressed()) {
+      TraceRecorder::record(TraceRecorder::BUTTON, static_cast<int8_t>((downButton.getId() << 1) | 1));
+    }
+    wake();
+  } else if (idleTime >= DIM_AFTER_MS && !dimmed) {
+    display.setDimmed(true);
+    dimmed = true;
+  }
+}
+
+template <class Display, class Features>
+void DeskController<Display, Features>::wake() {
+  lastActivity = millis();
+  if (dimmed) {
+    display.setDimmed(false);
+    dimmed = false;
+  }
+  if (!display.isPanelOn()) {
+    display.setPanelOn(true);
+    displayDirty = true;
+  }
+}
+
+template <class Display, class Features>
+void DeskController<Display, Features>::handleSerial() {
+  if (!Serial.available()) {
+    return;
+  }
+
+  wake();
+  char command = Serial.read();
+  TraceRecorder::record(TraceRecorder::COMMAND, command);
+  switch (command) {
+  case 'm':
+    // Learn motor deadband and speed curve
+    if (Features::CHARACTERIZATION && state.getState() == DeskState::IDLE) {
+      transitionTo(DeskState::CHARACTERIZING);
+    }
+    break;
+
+  case 's':
+    // Stall counter
+    Serial.print(F("Stalls: "));
+    Serial.println(stallDetector.getStallCount());
+    break;
+
+  case 'e':
+    // Encoder edges dropped by the glitch filter
+    Serial.print(F("Rejected edges: "));
+    Serial.println(encoder.getRejectedEdges());
+    break;
+
+#ifdef DUAL_LEG
+  case 'l':
+    // The legs were levelled by hand: take the current counts as in sync
+    legSync.align();
+    Serial.println(F("Legs aligned"));
+    break;
+
+#endif
+  case 'u':
+  case 'd':
+    // Soft limit at the current height
+    if (!state.isCalibrated()) {
+      Serial.println(F("Not calibrated"));
+    } else if (!state.setSoftLimit(command == 'u', state.getCurrentHeight())) {
+      Serial.println(F("Limits too close"));
+    } else {
+      printSpeedZones();
+    }
+    break;
+
+  case 'z':
+    printSpeedZones();
+    break;
+
+  case 'p':
+    // Per-move statistics and histograms
+    moveStats.startDump();
+    break;
+
+  case 't':
+    // Input trace; header gives the time and pulse count the trace ends at
+    if (!TraceRecorder::isLive()) {
+      Serial.print(F("TRACE,"));
+      Serial.print(static_cast<uint16_t>(millis()));
+      Serial.print(',');
+      Serial.println(encoder.getPulseCount());
+      TraceRecorder::startDump();
+    }
+    break;
+
+#ifndef NO_TRACE
+  case 'T':
+    // Live trace for test/test_replay, from a desk at rest; 'T' again ends it
+    if (TraceRecorder::isLive()) {
+      TraceRecorder::stopLive();
+    } else if (state.getState() == DeskState::IDLE && !coastPending) {
+      // Save the position first, so the image is exactly what a boot would restore
+      state.setPulseCount(encoder.getPulseCount());
+      state.saveToEEPROM();
+      unsigned long now = millis();
+      TraceRecorder::startLive(now);
+      Serial.print(F("LIVE,"));
+      Serial.print(now);
+      Serial.print(',');
+      Serial.println(encoder.getPulseCount());
+      state.printEEPROM(Serial);
+    }
+    break;
+#endif
+
+  case 'r':
+    // SRAM between heap and stack: now and the lowest since boot
+    Serial.print(F("Free RAM: "));
+    Serial.print(MemoryMonitor::getFreeMemory());
+    Serial.print(F(" min: "));
+    Serial.println(MemoryMonitor::getStackHighWater());
+    break;
+  }
+}
+
+template <class Display, class Features>
+void DeskController<Display, Features>::printSpeedZones() {
+  const SpeedZones& zones = state.getSpeedZones();
+  Serial.print(F("Soft limits: "));
+  Serial.print(zones.minHeight);
+  Serial.print('-');
+  Serial.print(zones.maxHeight);
+  Serial.print(F(" mm, slow over "));
+  Serial.print(zones.taperMM);
+  Serial.print(F(" mm to speed "));
+  Serial.println(zones.endSpeed);
 }
 
+// The one configuration this firmware is built with
+template class DeskController<DeskDisplay, DeskFeatures>;
@@ -4,41 +4,163 @@
 #include "ButtonHandler.h"
 #include "DeskState.h"
 #include "EndStop.h"
-#include "HeightDisplay.h"
+#include "GestureRecognizer.h"
+#include "LegSync.h"
+#include "MotorCharacterizer.h"
 #include "MotorControl.h"
+#include "MoveStats.h"
 #include "OpticalEncoder.h"
+#include "PowerManager.h"
+#include "StallDetector.h"
 
+// Table-driven desk state machine.
+//
+// Each DeskState::State has an entry, exit, per-tick and button-event handler
+// in STATE_TABLE (kept in flash). Only the active state's handlers run, and
+// motor commands, EEPROM writes and full-screen draws happen in the entry/exit
+// actions, so an idle desk does almost nothing per tick.
+//
+// The controller owns its components, so every call in the loop goes to a
+// known object. Display is any type with HeightDisplay's interface (NullDisplay
+// for headless builds); Features gives the optional features as compile-time
+// constants (see DeskConfig.h). Handlers of disabled features are left out of
+// STATE_TABLE, so the linker drops them together with their screens.
+template <class Display, class Features>
 class DeskController {
 public:
-  DeskController(ButtonHandler& upButton, ButtonHandler& downButton, EndStop& endStop, OpticalEncoder& encoder,
-                 MotorControl& motor, HeightDisplay& display);
+  DeskController();
 
   void init();
   void update();
 
 private:
-  void handleButtons();
-  void handleIdleButtons(bool up, bool down, bool downLong, bool bothLong, bool bothVeryLong);
-  void handlePresetButtons(bool up, bool down, bool both, bool bothLong);
-  void handleMovement();
-  void handleCalibration();
-  void handlePresetMode();
-  void updateDisplay();
+  struct StateHandlers {
+    void (DeskController::*enter)();
+    void (DeskController::*exit)();
+    void (DeskController::*update)();
+    void (DeskController::*event)(const ButtonEvent& event);
+    void (DeskController::*draw)(); // Full redraw, e.g. after a status overlay expired
+  };
+  static const StateHandlers STATE_TABLE[];
+
+  static void loadHandlers(DeskState::State s, StateHandlers& handlers);
+  void transitionTo(DeskState::State next);
+
+  // IDLE
+  void enterIdle();
+  void updateIdle();
+  void handleIdleEvent(const ButtonEvent& event);
+  void drawHeight();
+
+  // MOVING_UP / MOVING_DOWN
+  void enterMoving();
+  void exitMoving();
+  void updateMoving();
+  void handleMovingEvent(const ButtonEvent& event);
+
+  // PRESET_MODE
+  void enterPresetMode();
+  void updatePresetMode();
+  void handlePresetEvent(const ButtonEvent& event);
+  void drawPresetMode();
+
+  // CALIBRATING
+  void enterCalibrating();
+  void updateCalibrating();
+  void handleCalibrationEvent(const ButtonEvent& event);
+  void drawCalibration();
+  void startCalibrationDrive(bool up);
+  void stopCalibrationDrive();
+  void finishCalibration();
+
+#ifndef NO_CHARACTERIZATION
+  // CHARACTERIZING
+  void enterCharacterizing();
+  void exitCharacterizing();
+  void updateCharacterizing();
+  void handleCharacterizingEvent(const ButtonEvent& event);
+#endif
+
+  bool driveBlocked(bool up); // End stop or stall on a driven move; sets stopReason
+  void reportDriveStop();     // After the motor is stopped for driveBlocked()
+  float brakePoint(bool up) const;
+  uint8_t driveSpeed(bool up) const; // Zone speed at the current height, capped for preset moves
+  void beginCoast(float height);
+  void refreshHeight(bool moving);
+  void updatePowerSaving();
+  void wake();
+  void handleSerial();
+  void printSpeedZones();
+  void reportResetCause();
   void moveToPreset(uint8_t presetIndex);
   void saveCurrentPreset();
 
-  ButtonHandler& upButton;
-  ButtonHandler& downButton;
-  EndStop& endStop;
-  OpticalEncoder& encoder;
-  MotorControl& motor;
-  HeightDisplay& display;
+  ButtonHandler upButton;
+  ButtonHandler downButton;
+  EndStop endStop;
+  OpticalEncoder encoder;
+  MotorControl motor;
+#ifdef DUAL_LEG
+  // Second lifting column, kept level with the first
+  OpticalEncoder encoderB;
+  MotorControl motorB;
+  LegSync legSync;
+  bool legsLevelling; // Only the lagging leg is driven until the desk is level
+#endif
+  Display display;
   DeskState state;
+  GestureRecognizer gestures;
+#ifndef NO_CHARACTERIZATION
+  MotorCharacterizer characterizer; // 34-byte sample buffer
+#endif
+  StallDetector stallDetector;
+  MoveStats moveStats;
+  MoveStats::Reason stopReason; // Set by whatever ends the current move
+  unsigned long lastLoopStart;
+  PowerManager power;
+  unsigned long lastActivity; // Last button event, state change or desk movement
+  bool dimmed;
   unsigned long lastButtonPress;
+  bool chordEnteredPresets; // The chord that opened preset mode is still held
+
+  // Display bookkeeping: redraw only when the shown value changes
+  bool displayDirty;
+  float shownHeight;
+
+  // Motion planning
+  bool hasTarget; // Preset move in progress
+  float targetHeight;
+
+  bool endStopTriggered;   // Sampled once per loop
+  int8_t endStopDirection; // Direction that ran into the end stop, 0 when released
+  static const int8_t ENDSTOP_BOTH = 2; // Booted on the switch with no height to tell which end
+
+  // Stop distance measurement
+  bool coastPending;
+  bool coastUp;
+  uint8_t coastSpeed;
+  float coastStartHeight;
+
+  // Calibration progress (timed sub-state machine, never blocks)
+  static const uint8_t MAX_CAL_POINTS = 6;
+  enum CalibrationStep : uint8_t { CAL_POINT, CAL_MOVE, CAL_RESULT };
+  CalibrationStep calStep;
+  unsigned long calStepStart;
+  bool calAdjusting; // Up/Down pressed inside calibration, so its repeats count
+  int8_t calDrive;   // CAL_MOVE: held Up/Down drives the desk, 1 up, -1 down, 0 stopped
+  float calHeight;   // Height being entered for the next point
+  uint8_t calPoints; // Reference points recorded so far
+  long calPulses[MAX_CAL_POINTS];
+  int16_t calHeights[MAX_CAL_POINTS]; // 1/HeightTable::HEIGHT_SCALE mm
 
-  static const uint8_t MOTOR_SPEED = 200;           // ~78% of max speed
-  static const uint8_t PRESET_MOVE_SPEED = 150;     // Slower speed for preset moves
+  static const uint8_t UNCALIBRATED_SPEED = 200;   // ~78% of max speed while the limits are unknown
+  static const uint8_t PRESET_MOVE_SPEED = 150;    // Slower speed for preset moves
   static const unsigned long PRESET_TIMEOUT = 5000; // 5 seconds timeout for preset mode
+  static constexpr float TARGET_TOLERANCE = 1.0f; // Preset moves closer than this are skipped
+  static const unsigned long CAL_RESULT_MS = 2000; // How long calibration results stay up
+  static const uint8_t CAL_DRIVE_SPEED = 120;      // Slow enough to stop on a mark
+  static const unsigned long DIM_AFTER_MS = 30000;   // Idle time before the display dims
+  static const unsigned long SLEEP_AFTER_MS = 60000; // Idle time before display off and MCU sleep
 };
 
-#endif // DESKCONTROLLER_H
\ No newline at end of file
+#endif // DESKCONTROLLER_H
@@ -2,10 +2,19 @@
 
 DeskState::DeskState()
     : currentState(IDLE), currentHeight(0.0f), heightOffset(0.0f), calibrationStatus(false), currentPreset(0),
-      encoderSlitsPerMM(10.0f) {
+      encoderSlitsPerMM(10.0f), pulseCount(0) {
   for (uint8_t i = 0; i < MAX_PRESETS; i++) {
     presets[i] = 0.0f;
   }
+  for (uint8_t dir = 0; dir < 2; dir++) {
+    for (uint8_t bin = 0; bin < STOP_SPEED_BINS; bin++) {
+      stopDistances[dir][bin] = DEFAULT_STOP_DISTANCE;
+    }
+  }
+  zones.minHeight = DEFAULT_MIN_HEIGHT;
+  zones.maxHeight = DEFAULT_MAX_HEIGHT;
+  zones.taperMM = DEFAULT_TAPER_MM;
+  zones.endSpeed = DEFAULT_END_SPEED;
 }
 
 void DeskState::init() {
@@ -25,23 +34,8 @@ float DeskState::getCurrentHeight() const {
 }
 
 void DeskState::updateHeight(float height) {
-  // Only save if height changed significantly to avoid EEPROM wear
-  static unsigned long lastSaveTime = 0;
-  static float lastSavedHeight = 0.0f;
-  
+  // Persisted by the controller when a move has settled, not on every tick
   currentHeight = height;
-  
-  // Save to EEPROM if:
-  // - Height changed by more than 1mm AND
-  // - At least 5 seconds have passed since last save
-  float heightDiff = abs(height - lastSavedHeight);
-  unsigned long currentTime = millis();
-  
-  if (heightDiff > 1.0f && (currentTime - lastSaveTime) > 5000) {
-    saveToEEPROM();
-    lastSavedHeight = height;
-    lastSaveTime = currentTime;
-  }
 }
 
 float DeskState::getHeightOffset() const {
@@ -108,6 +102,9 @@ void DeskState::saveToEEPROM() {
   EEPROM.put(PRESETS_ADDRESS, presets);
   EEPROM.put(CURRENT_PRESET_ADDRESS, currentPreset);
   EEPROM.put(ENCODER_SLITS_PER_MM_ADDRESS, encoderSlitsPerMM);
+  EEPROM.put(STOP_DISTANCES_ADDRESS, stopDistances);
+  EEPROM.put(PULSE_COUNT_ADDRESS, pulseCount);
+  EEPROM.put(SPEED_ZONES_ADDRESS, zones);
 }
 
 void DeskState::loadFromEEPROM() {
@@ -117,6 +114,46 @@ void DeskState::loadFromEEPROM() {
   EEPROM.get(PRESETS_ADDRESS, presets);
   EEPROM.get(CURRENT_PRESET_ADDRESS, currentPreset);
   EEPROM.get(ENCODER_SLITS_PER_MM_ADDRESS, encoderSlitsPerMM);
+  EEPROM.get(STOP_DISTANCES_ADDRESS, stopDistances);
+  EEPROM.get(PULSE_COUNT_ADDRESS, pulseCount);
+  EEPROM.get(SPEED_ZONES_ADDRESS, zones);
+
+  if (pulseCount == -1) {
+    pulseCount = 0; // Erased EEPROM
+  }
+  if (zones.maxHeight - zones.minHeight < MIN_TRAVEL_MM || zones.taperMM == 0 || zones.endSpeed == 0) {
+    // Erased EEPROM (limits read as -1)
+    zones.minHeight = DEFAULT_MIN_HEIGHT;
+    zones.maxHeight = DEFAULT_MAX_HEIGHT;
+    zones.taperMM = DEFAULT_TAPER_MM;
+    zones.endSpeed = DEFAULT_END_SPEED;
+  }
+
+  // Erased EEPROM reads as 0xFFFF
+  for (uint8_t dir = 0; dir < 2; dir++) {
+    for (uint8_t bin = 0; bin < STOP_SPEED_BINS; bin++) {
+      if (stopDistances[dir][bin] > MAX_STOP_DISTANCE) {
+        stopDistances[dir][bin] = DEFAULT_STOP_DISTANCE;
+      }
+    }
+  }
+}
+
+void DeskState::printEEPROM(Print& out) const {
+  // 9 lines of ~45 characters, ~4 ms each at 115200 baud
+  for (int address = EEPROM_START_ADDRESS; address < EEPROM_END; address += PRINT_BYTES_PER_LINE) {
+    out.print(F("EEPROM,"));
+    out.print(address);
+    out.print(',');
+    for (int i = address; i < address + PRINT_BYTES_PER_LINE && i < EEPROM_END; i++) {
+      uint8_t value = EEPROM.read(i);
+      if (value < 0x10) {
+        out.print('0');
+      }
+      out.print(value, HEX);
+    }
+    out.println();
+  }
 }
 
 void DeskState::setEncoderSlitsPerMM(float slitsPerMM) {
@@ -126,4 +163,99 @@ void DeskState::setEncoderSlitsPerMM(float slitsPerMM) {
 
 float DeskState::getEncoderSlitsPerMM() const {
   return encoderSlitsPerMM;
-}
\ No newline at end of file
+}
+
+void DeskState::setPulseCount(long pulses) {
+  pulseCount = pulses;
+}
+
+long DeskState::getPulseCount() const {
+  return pulseCount;
+}
+
+float DeskState::getStopDistance(bool up, uint8_t speed) const {
+  return stopDistances[up ? 1 : 0][speed >> 6] * 0.1f;
+}
+
+void DeskState::learnStopDistance(bool up, uint8_t speed, float distanceMM) {
+  if (distanceMM < 0.0f) {
+    return;
+  }
+  uint16_t sample = static_cast<uint16_t>(distanceMM * 10.0f + 0.5f);
+  if (sample > MAX_STOP_DISTANCE) {
+    return;
+  }
+
+  // Exponential average (1/4 weight) so a single odd stop does not throw off the next one
+  uint16_t& entry = stopDistances[up ? 1 : 0][speed >> 6];
+  entry = static_cast<uint16_t>((3 * static_cast<uint32_t>(entry) + sample + 2) / 4);
+}
+
+const SpeedZones& DeskState::getSpeedZones() const {
+  return zones;
+}
+
+bool DeskState::setSoftLimit(bool upper, float height) {
+  int16_t limit = static_cast<int16_t>(height + 0.5f);
+  if (upper ? limit - zones.minHeight < MIN_TRAVEL_MM : zones.maxHeight - limit < MIN_TRAVEL_MM) {
+    return false;
+  }
+  if (upper) {
+    zones.maxHeight = limit;
+  } else {
+    zones.minHeight = limit;
+  }
+  saveToEEPROM();
+  return true;
+}
+
+uint8_t DeskState::getZoneSpeed(bool up, float height) const {
+  // Full speed mid-travel, linear taper to endSpeed at the limit being approached
+  float distance = up ? zones.maxHeight - height : height - zones.minHeight;
+  if (distance <= 0.0f) {
+    return zones.endSpeed;
+  }
+  if (distance >= zones.taperMM) {
+    return FULL_SPEED;
+  }
+  return zones.endSpeed + static_cast<uint8_t>((FULL_SPEED - zones.endSpeed) * distance / zones.taperMM);
+}
+
+void DeskState::saveMotorProfile(const MotorProfile& profile) {
+  EEPROM.put(MOTOR_PROFILE_ADDRESS, profile.marker);
+  EEPROM.put(MOTOR_PROFILE_ADDRESS + 1, profile.forwardDuty);
+  EEPROM.put(MOTOR_PROFILE_ADDRESS + 1 + sizeof(profile.forwardDuty), profile.backwardDuty);
+}
+
+void DeskState::loadMotorProfile(MotorProfile& profile) {
+  EEPROM.get(MOTOR_PROFILE_ADDRESS, profile.marker);
+  EEPROM.get(MOTOR_PROFILE_ADDRESS + 1, profile.forwardDuty);
+  EEPROM.get(MOTOR_PROFILE_ADDRESS + 1 + sizeof(profile.forwardDuty), profile.backwardDuty);
+}
+
+void DeskState::saveHeightTable(const HeightTable& table) {
+  EEPROM.put(HEIGHT_TABLE_ADDRESS, table.marker);
+  EEPROM.put(HEIGHT_TABLE_ADDRESS + 1, table.shift);
+  EEPROM.put(HEIGHT_TABLE_ADDRESS + 2, static_cast<int32_t>(table.basePulses));
+  EEPROM.put(HEIGHT_TABLE_ADDRESS + 2 + sizeof(int32_t), table.heights);
+}
+
+void DeskState::loadHeightTable(HeightTable& table) {
+  int32_t basePulses;
+  EEPROM.get(HEIGHT_TABLE_ADDRESS, table.marker);
+  EEPROM.get(HEIGHT_TABLE_ADDRESS + 1, table.shift);
+  EEPROM.get(HEIGHT_TABLE_ADDRESS + 2, basePulses);
+  EEPROM.get(HEIGHT_TABLE_ADDRESS + 2 + sizeof(int32_t), table.heights);
+  table.basePulses = basePulses;
+}
+
+void DeskState::saveResetLog(const ResetLog& log) {
+  EEPROM.put(RESET_LOG_ADDRESS, log);
+}
+
+void DeskState::loadResetLog(ResetLog& log) {
+  EEPROM.get(RESET_LOG_ADDRESS, log);
+  if (log.watchdogResets == 0xFFFF) {
+    log.watchdogResets = 0; // Erased EEPROM
+  }
+}
@@ -4,9 +4,21 @@
 #include <Arduino.h>
 #include <EEPROM.h>
 
+#include "MotorControl.h"
+#include "OpticalEncoder.h"
+#include "Watchdog.h"
+
+// Soft travel limits and the slow zones inside them, in mm
+struct SpeedZones {
+  int16_t minHeight; // The desk stops here
+  int16_t maxHeight;
+  uint8_t taperMM;  // Speed ramps down over this distance before a limit
+  uint8_t endSpeed; // Speed left on reaching a limit
+};
+
 class DeskState {
 public:
-  enum State { IDLE, MOVING_UP, MOVING_DOWN, CALIBRATING, PRESET_MODE, PRESET_EDIT_MODE };
+  enum State { IDLE, MOVING_UP, MOVING_DOWN, CALIBRATING, PRESET_MODE, PRESET_EDIT_MODE, CHARACTERIZING };
 
   DeskState();
   void init();
@@ -35,10 +47,37 @@ public:
   // Encoder configuration
   void setEncoderSlitsPerMM(float slitsPerMM);
   float getEncoderSlitsPerMM() const;
-  
+  // Encoder position at the last settled stop, restored at boot; caller persists
+  void setPulseCount(long pulses);
+  long getPulseCount() const;
+
+  // Learned stopping distance (coast after the motor is cut), per direction and speed
+  static const uint8_t STOP_SPEED_BINS = 4;
+  float getStopDistance(bool up, uint8_t speed) const;
+  void learnStopDistance(bool up, uint8_t speed, float distanceMM); // Caller persists
+
+  // Soft limits and speed zones (only meaningful once calibrated)
+  const SpeedZones& getSpeedZones() const;
+  bool setSoftLimit(bool upper, float height); // False if the limits would be closer than MIN_TRAVEL_MM
+  uint8_t getZoneSpeed(bool up, float height) const; // Highest speed allowed at height in that direction
+  static const uint8_t FULL_SPEED = 255;
+
+  // Motor speed profile (kept in MotorControl, only persisted here)
+  void saveMotorProfile(const MotorProfile& profile);
+  void loadMotorProfile(MotorProfile& profile);
+
+  // Multi-point height calibration (kept in OpticalEncoder, only persisted here)
+  void saveHeightTable(const HeightTable& table);
+  void loadHeightTable(HeightTable& table);
+
+  // Reset cause history (kept by the controller, only persisted here)
+  void saveResetLog(const ResetLog& log);
+  void loadResetLog(ResetLog& log);
+
   // EEPROM operations
   void saveToEEPROM();
   void loadFromEEPROM();
+  void printEEPROM(Print& out) const; // "EEPROM,address,hex" lines of everything stored
 
 private:
   State currentState;
@@ -50,6 +89,25 @@ private:
   
   // Encoder configuration
   float encoderSlitsPerMM;
+  int32_t pulseCount; // Fixed width, so the EEPROM image reads the same on the host
+
+  uint16_t stopDistances[2][STOP_SPEED_BINS]; // 0.1 mm units, [0] = down, [1] = up
+  SpeedZones zones;
+
+  static const uint16_t DEFAULT_STOP_DISTANCE = 30; // 3 mm
+  static const uint16_t MAX_STOP_DISTANCE = 500;    // 50 mm, anything above is a bad sample
+
+  // Default zones: the old fixed soft limits, slowing over the last 80 mm
+  static const int16_t DEFAULT_MIN_HEIGHT = 600;
+  static const int16_t DEFAULT_MAX_HEIGHT = 1200;
+  static const uint8_t DEFAULT_TAPER_MM = 80;
+  static const uint8_t DEFAULT_END_SPEED = 80;
+  static const int16_t MIN_TRAVEL_MM = 50;
+
+  // MotorProfile and HeightTable are stored field by field, without the padding
+  // a host compiler adds, so the image reads the same in the replay harness
+  static const int MOTOR_PROFILE_SIZE = 1 + 2 * MotorProfile::PROFILE_POINTS * sizeof(uint16_t);
+  static const int HEIGHT_TABLE_SIZE = 2 + sizeof(int32_t) + (HeightTable::SEGMENTS + 1) * sizeof(int16_t);
 
   static const int EEPROM_START_ADDRESS = 0;
   static const int CALIBRATION_FLAG_ADDRESS = EEPROM_START_ADDRESS;
@@ -58,6 +116,14 @@ private:
   static const int PRESETS_ADDRESS = HEIGHT_OFFSET_ADDRESS + sizeof(float);
   static const int CURRENT_PRESET_ADDRESS = PRESETS_ADDRESS + (MAX_PRESETS * sizeof(float));
   static const int ENCODER_SLITS_PER_MM_ADDRESS = CURRENT_PRESET_ADDRESS + sizeof(uint8_t);
+  static const int MOTOR_PROFILE_ADDRESS = ENCODER_SLITS_PER_MM_ADDRESS + sizeof(float);
+  static const int STOP_DISTANCES_ADDRESS = MOTOR_PROFILE_ADDRESS + MOTOR_PROFILE_SIZE;
+  static const int HEIGHT_TABLE_ADDRESS = STOP_DISTANCES_ADDRESS + (2 * STOP_SPEED_BINS * sizeof(uint16_t));
+  static const int RESET_LOG_ADDRESS = HEIGHT_TABLE_ADDRESS + HEIGHT_TABLE_SIZE;
+  static const int PULSE_COUNT_ADDRESS = RESET_LOG_ADDRESS + sizeof(ResetLog);
+  static const int SPEED_ZONES_ADDRESS = PULSE_COUNT_ADDRESS + sizeof(int32_t);
+  static const int EEPROM_END = SPEED_ZONES_ADDRESS + sizeof(SpeedZones);
+  static const uint8_t PRINT_BYTES_PER_LINE = 16;
 };
 
 #endif // DESKSTATE_H
@@ -3,14 +3,24 @@
 
 #include <Arduino.h>
 
+#include "FastPin.h"
+#include "Pins.h"
+
+// End stop switch on ENDSTOP_PIN, read with direct port I/O
 class EndStop {
 public:
-  EndStop(uint8_t pin);
-  void init();
-  bool isTriggered() const;
+  EndStop() {}
+
+  void init() {
+    Pin::setInputPullup();
+  }
+
+  bool isTriggered() const {
+    return Pin::isLow(); // Active LOW
+  }
 
 private:
-  uint8_t pin;
+  typedef FastPin<ENDSTOP_PIN> Pin;
 };
 
 #endif // ENDSTOP_H
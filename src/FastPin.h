@@ -0,0 +1,70 @@
+#ifndef FASTPIN_H
+#define FASTPIN_H
+
+#include <Arduino.h>
+
+// Direct port I/O for ATmega328P with everything resolved at compile time.
+//
+// digitalRead()/digitalWrite() look the port and bit up in flash tables and
+// check for PWM timers on every call. With the pin as a template argument the
+// register and mask are constants, so read() compiles to a single SBIC/IN and
+// setters to SBI/CBI. Arduino numbering: D0-D7 = PORTD, D8-D13 = PORTB,
+// A0-A5 (14-19) = PORTC.
+template <uint8_t Pin>
+class FastPin {
+  static_assert(Pin < 20, "ATmega328P only has pins 0..19");
+
+public:
+  static const uint8_t MASK = 1 << (Pin < 8 ? Pin : (Pin < 14 ? Pin - 8 : Pin - 14));
+
+  static volatile uint8_t& inputReg() {
+    return Pin < 8 ? PIND : (Pin < 14 ? PINB : PINC);
+  }
+  static volatile uint8_t& outputReg() {
+    return Pin < 8 ? PORTD : (Pin < 14 ? PORTB : PORTC);
+  }
+  static volatile uint8_t& directionReg() {
+    return Pin < 8 ? DDRD : (Pin < 14 ? DDRB : DDRC);
+  }
+
+  static void setInput() {
+    directionReg() &= ~MASK;
+    outputReg() &= ~MASK;
+  }
+  static void setInputPullup() {
+    directionReg() &= ~MASK;
+    outputReg() |= MASK;
+  }
+  static void setOutput() {
+    directionReg() |= MASK;
+  }
+  static bool read() {
+    return inputReg() & MASK;
+  }
+  static bool isLow() {
+    return !(inputReg() & MASK);
+  }
+  static void write(bool high) {
+    if (high) {
+      outputReg() |= MASK;
+    } else {
+      outputReg() &= ~MASK;
+    }
+  }
+};
+
+// Timer1 compare register behind a PWM pin (D9 = OC1A, D10 = OC1B)
+template <uint8_t Pin>
+class Timer1Pwm {
+  static_assert(Pin == 9 || Pin == 10, "Only D9 (OC1A) and D10 (OC1B) are driven by Timer1");
+
+public:
+  static volatile uint16_t& compareReg() {
+    return Pin == 9 ? OCR1A : OCR1B;
+  }
+  static void write(uint16_t duty) {
+    compareReg() = duty;
+  }
+};
+
+#endif // FASTPIN_H
@@ -0,0 +1,169 @@
+#include "GestureRecognizer.h"
+
+GestureRecognizer::GestureRecognizer(ButtonHandler& upButton, ButtonHandler& downButton)
+    : upButton(upButton), downButton(downButton), phase(NONE_PRESSED), activeButton(ButtonEvent::UP), pressTime(0),
+      nextRepeat(0), longFired(false), veryLongFired(false), eventHead(0), eventTail(0) {
+  for (uint8_t i = 0; i < 2; i++) {
+    buttons[i].pressed = false;
+    buttons[i].lastChange = 0;
+  }
+}
+
+void GestureRecognizer::update() {
+  ButtonEdge edge;
+  while (ButtonHandler::popEdge(edge)) {
+    uint8_t button = (edge.button == upButton.getId()) ? ButtonEvent::UP : ButtonEvent::DOWN;
+    acceptEdge(button, edge.pressed, edge.time);
+  }
+
+  uint16_t now = static_cast<uint16_t>(millis());
+
+  // After the lockout, resync with the pin in case the final edge fell inside it
+  for (uint8_t i = 0; i < 2; i++) {
+    bool level = (i == ButtonEvent::UP) ? upButton.isPressed() : downButton.isPressed();
+    if (level != buttons[i].pressed && static_cast<uint16_t>(now - buttons[i].lastChange) >= DEBOUNCE_DELAY) {
+      buttons[i].pressed = level;
+      buttons[i].lastChange = now;
+      onChange(i, level, now);
+    }
+  }
+
+  runTimers(now);
+}
+
+bool GestureRecognizer::poll(ButtonEvent& event) {
+  if (eventTail == eventHead) {
+    return false;
+  }
+  event = events[eventTail];
+  eventTail = (eventTail + 1) & (EVENT_QUEUE_SIZE - 1);
+  return true;
+}
+
+void GestureRecognizer::acceptEdge(uint8_t button, bool pressed, uint16_t time) {
+  Debounce& state = buttons[button];
+  if (pressed == state.pressed || static_cast<uint16_t>(time - state.lastChange) < DEBOUNCE_DELAY) {
+    return;
+  }
+  state.pressed = pressed;
+  state.lastChange = time;
+  onChange(button, pressed, time);
+}
+
+void GestureRecognizer::onChange(uint8_t button, bool pressed, uint16_t time) {
+  ButtonEvent::Button which = static_cast<ButtonEvent::Button>(button);
+
+  switch (phase) {
+  case NONE_PRESSED:
+    if (pressed) {
+      phase = PENDING;
+      activeButton = button;
+      pressTime = time;
+      longFired = false;
+      veryLongFired = false;
+    }
+    break;
+
+  case PENDING:
+    if (pressed) {
+      phase = CHORDED;
+      pressTime = time;
+      longFired = false;
+      veryLongFired = false;
+      emit(ButtonEvent::CHORD, ButtonEvent::BOTH);
+    } else {
+      // Tap shorter than the chord window
+      emit(ButtonEvent::PRESS, which);
+      emit(ButtonEvent::RELEASE, which);
+      phase = NONE_PRESSED;
+    }
+    break;
+
+  case SINGLE:
+    if (pressed) {
+      // Second button joined a running press: end the single press, start a chord
+      emit(ButtonEvent::RELEASE, static_cast<ButtonEvent::Button>(activeButton));
+      phase = CHORDED;
+      pressTime = time;
+      longFired = false;
+      veryLongFired = false;
+      emit(ButtonEvent::CHORD, ButtonEvent::BOTH);
+    } else {
+      emit(ButtonEvent::RELEASE, which);
+      phase = NONE_PRESSED;
+    }
+    break;
+
+  case CHORDED:
+    if (!pressed) {
+      emit(longFired ? ButtonEvent::CHORD_RELEASE : ButtonEvent::CHORD_TAP, ButtonEvent::BOTH);
+      phase = CHORD_RELEASING;
+    }
+    break;
+
+  case CHORD_RELEASING:
+    // Swallow everything until both buttons are up
+    if (!isDown(ButtonEvent::UP) && !isDown(ButtonEvent::DOWN)) {
+      phase = NONE_PRESSED;
+    }
+    break;
+  }
+}
+
+void GestureRecognizer::runTimers(uint16_t now) {
+  uint16_t held = now - pressTime;
+  ButtonEvent::Button which = static_cast<ButtonEvent::Button>(activeButton);
+
+  switch (phase) {
+  case PENDING:
+    if (held >= CHORD_WINDOW) {
+      phase = SINGLE;
+      nextRepeat = pressTime + REPEAT_DELAY;
+      emit(ButtonEvent::PRESS, which);
+    }
+    break;
+
+  case SINGLE:
+    if (!longFired && held >= LONG_PRESS_TIME) {
+      longFired = true;
+      emit(ButtonEvent::LONG, which);
+    }
+    if (!veryLongFired && held >= VERY_LONG_PRESS_TIME) {
+      veryLongFired = true;
+      emit(ButtonEvent::VERY_LONG, which);
+    }
+    if (static_cast<int16_t>(now - nextRepeat) >= 0) {
+      nextRepeat += REPEAT_INTERVAL;
+      emit(ButtonEvent::REPEAT, which);
+    }
+    break;
+
+  case CHORDED:
+    if (!longFired && held >= BOTH_BUTTONS_TIME) {
+      longFired = true;
+      emit(ButtonEvent::CHORD_LONG, ButtonEvent::BOTH);
+    }
+    if (!veryLongFired && held >= VERY_LONG_PRESS_TIME) {
+      veryLongFired = true;
+      emit(ButtonEvent::CHORD_VERY_LONG, ButtonEvent::BOTH);
+    }
+    break;
+
+  default:
+    break;
+  }
+}
+
+void GestureRecognizer::emit(ButtonEvent::Type type, ButtonEvent::Button button) {
+  uint8_t next = (eventHead + 1) & (EVENT_QUEUE_SIZE - 1);
+  if (next == eventTail) {
+    return; // Controller not draining; drop rather than overwrite older events
+  }
+  events[eventHead].type = type;
+  events[eventHead].button = button;
+  eventHead = next;
+}
+
+bool GestureRecognizer::isDown(uint8_t button) const {
+  return buttons[button].pressed;
+}
@@ -0,0 +1,77 @@
+#ifndef GESTURERECOGNIZER_H
+#define GESTURERECOGNIZER_H
+
+#include "ButtonHandler.h"
+
+struct ButtonEvent {
+  enum Type : uint8_t {
+    PRESS,           // Single button pressed (no chord within CHORD_WINDOW)
+    RELEASE,         // Single button released
+    LONG,            // Single button held LONG_PRESS_TIME
+    VERY_LONG,       // Single button held VERY_LONG_PRESS_TIME
+    REPEAT,          // Auto-repeat while a single button is held
+    CHORD,           // Both buttons pressed
+    CHORD_LONG,      // Both held BOTH_BUTTONS_TIME
+    CHORD_VERY_LONG, // Both held VERY_LONG_PRESS_TIME
+    CHORD_TAP,       // Chord released before CHORD_LONG
+    CHORD_RELEASE    // Chord released after CHORD_LONG
+  };
+  enum Button : uint8_t { UP, DOWN, BOTH };
+
+  Type type;
+  Button button;
+};
+
+// Turns the raw edge queue of two ButtonHandlers into discrete gesture events.
+//
+// Edges are debounced on the leading edge (accepted immediately, then locked
+// out for DEBOUNCE_DELAY), so presses are not delayed by the debounce. A single
+// press is held back for CHORD_WINDOW so that pressing both buttons never starts
+// a move first; once one button is down, pressing the other still becomes a chord.
+class GestureRecognizer {
+public:
+  GestureRecognizer(ButtonHandler& upButton, ButtonHandler& downButton);
+
+  void update(); // Drain edges and run timers; call once per tick
+  bool poll(ButtonEvent& event);
+
+private:
+  enum Phase { NONE_PRESSED, PENDING, SINGLE, CHORDED, CHORD_RELEASING };
+
+  struct Debounce {
+    bool pressed;
+    uint16_t lastChange;
+  };
+
+  void acceptEdge(uint8_t button, bool pressed, uint16_t time);
+  void onChange(uint8_t button, bool pressed, uint16_t time);
+  void runTimers(uint16_t now);
+  void emit(ButtonEvent::Type type, ButtonEvent::Button button);
+  bool isDown(uint8_t button) const;
+
+  ButtonHandler& upButton;
+  ButtonHandler& downButton;
+  Debounce buttons[2]; // Indexed by ButtonEvent::UP / DOWN
+
+  Phase phase;
+  uint8_t activeButton;
+  uint16_t pressTime;
+  uint16_t nextRepeat;
+  bool longFired;
+  bool veryLongFired;
+
+  static const uint8_t EVENT_QUEUE_SIZE = 8; // Must be a power of two
+  ButtonEvent events[EVENT_QUEUE_SIZE];
+  uint8_t eventHead;
+  uint8_t eventTail;
+
+  static const uint16_t DEBOUNCE_DELAY = 50;         // milliseconds
+  static const uint16_t CHORD_WINDOW = 60;           // milliseconds to press the second button
+  static const uint16_t LONG_PRESS_TIME = 1000;      // milliseconds
+  static const uint16_t BOTH_BUTTONS_TIME = 2000;    // milliseconds for both buttons
+  static const uint16_t VERY_LONG_PRESS_TIME = 5000; // milliseconds
+  static const uint16_t REPEAT_DELAY = 500;          // milliseconds before auto-repeat starts
+  static const uint16_t REPEAT_INTERVAL = 50;        // milliseconds between repeats
+};
+
+#endif // GESTURERECOGNIZER_H
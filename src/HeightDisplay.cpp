@@ -4,65 +4,250 @@
 #include <Arduino.h>
 #include <Wire.h>
 
+#include "FastPin.h"
+#include "Pins.h"
+#include "TraceRecorder.h"
+
 HeightDisplay::HeightDisplay() 
   : display(SCREEN_WIDTH, SCREEN_HEIGHT, &Wire, OLED_RESET),
     currentMode(NORMAL),
-    lastUpdate(0),
-    animationToggle(false) {}
+    present(false),
+    lastProbe(0),
+    dimmed(false),
+    panelOn(true),
+    overlayActive(false),
+    redrawRequested(false),
+    overlayStart(0),
+    overlayDuration(0),
+    overlaySuccess(false),
+    pendingHeight(0.0f),
+    pendingDirection(0),
+    heightPending(false),
+    heightOnPanel(false),
+    shownDirection(0),
+    lastFrame(0) {
+  overlayMessage[0] = '\0';
+}
 
 void HeightDisplay::init() {
-  if (!display.begin(SSD1306_SWITCHCAPVCC, SCREEN_ADDRESS)) {
-    Serial.println(F("SSD1306 allocation failed"));
-    return;
+  // Only the bus is set up here; update() finds the panel and the owner paints it,
+  // so boot never waits for the display
+  Wire.begin();
+  Wire.setWireTimeout(I2C_TIMEOUT_US, true);
+  lastProbe = millis() - REPROBE_INTERVAL_MS;
+}
+
+void HeightDisplay::update() {
+  if (overlayActive && millis() - overlayStart >= overlayDuration) {
+    overlayActive = false;
+    redrawRequested = true;
   }
 
-  showBootScreen();
-  delay(1000);
-  currentMode = NORMAL;
+  if (!present && millis() - lastProbe >= REPROBE_INTERVAL_MS) {
+    if (connect()) {
+      Serial.print(F("Display ready at "));
+      Serial.print(millis());
+      Serial.println(F(" ms"));
+      if (overlayActive) {
+        drawOverlay(); // Requested while the panel was not up yet
+      } else {
+        redrawRequested = true;
+      }
+    }
+  }
+
+  if (heightPending && present && panelOn && !overlayActive) {
+    // Layout changes and moving frames use the fast slot, a resting desk the slow one
+    unsigned long interval = IDLE_FRAME_MS;
+    if (pendingDirection != 0 || pendingDirection != shownDirection || !heightOnPanel) {
+      interval = MOVING_FRAME_MS;
+    }
+    if (millis() - lastFrame >= interval) {
+      drawHeightFrame();
+    }
+  }
 }
 
-void HeightDisplay::update() {
-  if (shouldAnimate()) {
-    updateAnimations();
-    lastUpdate = millis();
+bool HeightDisplay::isPresent() const {
+  return present;
+}
+
+bool HeightDisplay::probe() {
+  Wire.beginTransmission(SCREEN_ADDRESS);
+  return endTransfer();
+}
+
+bool HeightDisplay::connect() {
+  lastProbe = millis();
+  // Wire is set up by init(); the driver only allocates its buffer and sends the init sequence
+  present = probe() && display.begin(SSD1306_SWITCHCAPVCC, SCREEN_ADDRESS, true, false) && probe();
+  heightOnPanel = false; // begin() cleared the panel
+  if (present) {
+    display.dim(dimmed);
+    panelOn = true;
   }
+  return present;
 }
 
-void HeightDisplay::showHeight(float heightMM, bool isMoving) {
-  clearDisplay();
+void HeightDisplay::flush() {
+  sendPages(0, SCREEN_HEIGHT / 8 - 1);
+}
+
+bool HeightDisplay::sendPages(uint8_t firstPage, uint8_t lastPage) {
+  // Sent here instead of with the driver's display(), which does not report errors:
+  // the frame ends at the first transfer that is not acknowledged or times out,
+  // so a dead panel costs at most one I2C_TIMEOUT_US
+  Wire.setClock(I2C_FAST_CLOCK);
+  Wire.beginTransmission(SCREEN_ADDRESS);
+  Wire.write(CONTROL_COMMANDS);
+  Wire.write(SSD1306_PAGEADDR);
+  Wire.write(firstPage);
+  Wire.write(lastPage);
+  Wire.write(SSD1306_COLUMNADDR);
+  Wire.write(static_cast<uint8_t>(0)); // First column
+  Wire.write(SCREEN_WIDTH - 1);
+  bool ok = endTransfer();
+
+  const uint8_t* data = display.getBuffer() + firstPage * SCREEN_WIDTH;
+  uint16_t remaining = (lastPage - firstPage + 1) * SCREEN_WIDTH;
+  while (ok && remaining > 0) {
+    uint8_t chunk = I2C_CHUNK;
+    if (remaining < chunk) {
+      chunk = remaining;
+    }
+    Wire.beginTransmission(SCREEN_ADDRESS);
+    Wire.write(CONTROL_DATA);
+    Wire.write(data, chunk);
+    ok = endTransfer();
+    data += chunk;
+    remaining -= chunk;
+  }
+  Wire.setClock(I2C_STANDARD_CLOCK);
+
+  if (!ok) {
+    markLost();
+    return false;
+  }
+  TraceRecorder::recordCount(firstPage == 0 && lastPage == SCREEN_HEIGHT / 8 - 1 ? TraceRecorder::FRAME
+                                                                                 : TraceRecorder::DIGITS,
+                             1);
+  return true;
+}
+
+bool HeightDisplay::endTransfer() {
+  bool acked = Wire.endTransmission() == 0;
+  if (Wire.getWireTimeoutFlag()) {
+    Wire.clearWireTimeoutFlag();
+    recoverBus();
+    return false;
+  }
+  return acked;
+}
+
+void HeightDisplay::markLost() {
+  present = false;
+  lastProbe = millis();
+  Serial.println(F("Display lost"));
+}
+
+void HeightDisplay::recoverBus() {
+  // A slave stuck mid-byte holds SDA low. Clock it out by hand, then send a STOP.
+  Wire.end();
+  FastPin<I2C_SDA_PIN>::setInputPullup();
+  FastPin<I2C_SCL_PIN>::write(true);
+  FastPin<I2C_SCL_PIN>::setOutput();
+  for (uint8_t i = 0; i < 9 && FastPin<I2C_SDA_PIN>::isLow(); i++) {
+    FastPin<I2C_SCL_PIN>::write(false);
+    delayMicroseconds(5);
+    FastPin<I2C_SCL_PIN>::write(true);
+    delayMicroseconds(5);
+  }
+  FastPin<I2C_SDA_PIN>::write(false);
+  FastPin<I2C_SDA_PIN>::setOutput();
+  delayMicroseconds(5);
+  FastPin<I2C_SDA_PIN>::setInputPullup(); // SDA rising while SCL is high
+  delayMicroseconds(5);
+  FastPin<I2C_SCL_PIN>::setInputPullup();
+
+  Wire.begin();
+  Wire.setWireTimeout(I2C_TIMEOUT_US, true);
+}
+
+bool HeightDisplay::consumeRedrawRequest() {
+  bool requested = redrawRequested;
+  redrawRequested = false;
+  return requested;
+}
+
+void HeightDisplay::setDimmed(bool dimmed) {
+  this->dimmed = dimmed;
+  if (present) {
+    display.dim(dimmed);
+  }
+}
+
+void HeightDisplay::setPanelOn(bool on) {
+  if (on == panelOn) {
+    return;
+  }
+  panelOn = on;
+  if (present) {
+    display.ssd1306_command(on ? SSD1306_DISPLAYON : SSD1306_DISPLAYOFF);
+  }
+}
+
+bool HeightDisplay::isPanelOn() const {
+  return panelOn;
+}
+
+void HeightDisplay::showHeight(float heightMM, int8_t direction) {
+  // Drawn by update() within the frame budget
+  pendingHeight = heightMM;
+  pendingDirection = direction;
+  heightPending = true;
+}
+
+void HeightDisplay::drawHeightFrame() {
+  bool fullFrame = !heightOnPanel || pendingDirection != shownDirection;
   currentMode = NORMAL;
-  
-  // Show large height number in center
+  shownDirection = pendingDirection;
+  heightPending = false;
+  lastFrame = millis();
+
+  if (fullFrame) {
+    clearDisplay();
+    heightOnPanel = true;
+    // Direction label from the commanded motion, "DESK" at rest
+    if (pendingDirection != 0) {
+      centerText(pendingDirection > 0 ? "UP" : "DOWN", 2, 2);
+    } else {
+      centerText("DESK", 2, 1);
+    }
+    centerText("mm", 50, 1);
+  } else {
+    display.fillRect(0, DIGITS_Y, SCREEN_WIDTH, 24, SSD1306_BLACK);
+  }
+
+  // Large height number in center (text size 3)
   char heightStr[10];
-  snprintf(heightStr, sizeof(heightStr), "%.1f", (double)heightMM);
-  
-  // Large height display (text size 3)
+  snprintf(heightStr, sizeof(heightStr), "%.1f", (double)pendingHeight);
   display.setTextSize(3);
   int textWidth = strlen(heightStr) * 18; // Each char is ~18 pixels wide at size 3
   int x = (SCREEN_WIDTH - textWidth) / 2;
-  display.setCursor(x, 20);
+  display.setCursor(x, DIGITS_Y);
   display.print(heightStr);
-  
-  // Small "mm" unit below
-  display.setTextSize(1);
-  centerText("mm", 50, 1);
-  
-  // Movement indicator if moving
-  if (isMoving) {
-    display.setTextSize(2);
-    if (animationToggle) {
-      centerText(heightMM > 0 ? "UP" : "DOWN", 2, 2);
-    }
+
+  if (fullFrame) {
+    flush();
   } else {
-    // Show "DESK" label when static
-    display.setTextSize(1);
-    centerText("DESK", 2, 1);
+    sendPages(DIGITS_FIRST_PAGE, DIGITS_LAST_PAGE);
   }
-  
-  display.display();
 }
 
 void HeightDisplay::showPresetMode(uint8_t presetNumber, float presetHeight) {
+  if (!present || overlayActive) {
+    return;
+  }
   clearDisplay();
   currentMode = PRESET_MODE;
   
@@ -82,10 +267,13 @@ void HeightDisplay::showPresetMode(uint8_t presetNumber, float presetHeight) {
   display.setTextSize(1);
   centerText(heightStr, 55, 1);
   
-  display.display();
+  flush();
 }
 
 void HeightDisplay::showCalibrationMode(float currentHeight, bool showInstructions) {
+  if (!present || overlayActive) {
+    return;
+  }
   clearDisplay();
   currentMode = HEIGHT_CALIBRATION;
   
@@ -93,7 +281,7 @@ void HeightDisplay::showCalibrationMode(float currentHeight, bool showInstructio
   display.setTextSize(1);
   centerText("CALIBRATION", 2, 1);
   
-  if (showInstructions && animationToggle) {
+  if (showInstructions) {
     // Large instruction text
     display.setTextSize(2);
     centerText("UP/DOWN", 20, 2);
@@ -112,16 +300,30 @@ void HeightDisplay::showCalibrationMode(float currentHeight, bool showInstructio
     centerText("mm", 50, 1);
   }
   
-  display.display();
+  flush();
+}
+
+void HeightDisplay::showStatusMessage(const char* message, bool isSuccess, unsigned long durationMs) {
+  // Kept even while the panel is absent, so a message from before it came up is still shown
+  strncpy(overlayMessage, message, MAX_MESSAGE_LENGTH);
+  overlayMessage[MAX_MESSAGE_LENGTH] = '\0';
+  overlaySuccess = isSuccess;
+  overlayActive = true;
+  overlayStart = millis();
+  overlayDuration = durationMs;
+  drawOverlay();
 }
 
-void HeightDisplay::showStatusMessage(const char* message, bool isSuccess) {
+void HeightDisplay::drawOverlay() {
+  if (!present) {
+    return;
+  }
   clearDisplay();
   currentMode = STATUS_MESSAGE;
   
   // Large status icon at top
   display.setTextSize(3);
-  if (isSuccess) {
+  if (overlaySuccess) {
     centerText("OK", 8, 3);
   } else {
     centerText("!!", 8, 3);
@@ -129,12 +331,15 @@ void HeightDisplay::showStatusMessage(const char* message, bool isSuccess) {
   
   // Message below in large text
   display.setTextSize(2);
-  centerText(message, 35, 2);
+  centerText(overlayMessage, 35, 2);
   
-  display.display();
+  flush();
 }
 
 void HeightDisplay::showError(const char* errorMessage) {
+  if (!present) {
+    return;
+  }
   clearDisplay();
   currentMode = ERROR;
   
@@ -146,10 +351,13 @@ void HeightDisplay::showError(const char* errorMessage) {
   display.setTextSize(1);
   centerText(errorMessage, 35, 1);
   
-  display.display();
+  flush();
 }
 
 void HeightDisplay::showBootScreen() {
+  if (!present) {
+    return;
+  }
   clearDisplay();
   
   // Large title
@@ -161,10 +369,13 @@ void HeightDisplay::showBootScreen() {
   display.setTextSize(1);
   centerText("v1.0", 55, 1);
   
-  display.display();
+  flush();
 }
 
 void HeightDisplay::clearDisplay() {
+  // Whatever is drawn next replaces the height screen; the owner resends the height when it returns
+  heightPending = false;
+  heightOnPanel = false;
   display.clearDisplay();
   display.setTextColor(SSD1306_WHITE);
 }
@@ -179,26 +390,15 @@ void HeightDisplay::centerText(const char* text, int y, int textSize) {
   display.print(text);
 }
 
-void HeightDisplay::updateAnimations() {
-  animationToggle = !animationToggle;
-  
-  // Redraw current screen if it has animations
-  if (currentMode == HEIGHT_CALIBRATION || 
-      (currentMode == NORMAL && animationToggle)) {
-    // Trigger a refresh in the main controller
-  }
-}
-
-bool HeightDisplay::shouldAnimate() {
-  return (millis() - lastUpdate) >= ANIMATION_INTERVAL;
-}
-
 // Legacy compatibility methods
 void HeightDisplay::showMessage(const char* message) {
   showStatusMessage(message, true);
 }
 
-void HeightDisplay::showEncoderCalibrationMode(uint8_t step, float startHeight, float endHeight, long pulseCount) {
+void HeightDisplay::showEncoderCalibrationMode(uint8_t pointNumber, float height, bool done, float slitsPerMM) {
+  if (!present || overlayActive) {
+    return;
+  }
   clearDisplay();
   currentMode = CALIBRATION;
   
@@ -206,39 +406,27 @@ void HeightDisplay::showEncoderCalibrationMode(uint8_t step, float startHeight,
   display.setTextSize(1);
   centerText("ENCODER CAL", 2, 1);
   
-  if (step == 0) {
-    // Step 1: Enter start height
-    display.setTextSize(2);
-    centerText("START HEIGHT", 15, 2);
-    
-    char heightStr[10];
-    snprintf(heightStr, sizeof(heightStr), "%.1f", (double)startHeight);
-    display.setTextSize(3);
-    centerText(heightStr, 35, 3);
-    
-    display.setTextSize(1);
-    centerText("Up/Down: Adjust | Both: Next", 56, 1);
-    
-  } else if (step == 1) {
-    // Step 2: Move desk and enter end height
+  if (!done) {
+    // Enter the height of reference point N at the current desk position
+    char title[10];
+    snprintf(title, sizeof(title), "POINT %d", pointNumber);
     display.setTextSize(2);
-    centerText("END HEIGHT", 15, 2);
+    centerText(title, 15, 2);
     
     char heightStr[10];
-    snprintf(heightStr, sizeof(heightStr), "%.1f", (double)endHeight);
+    snprintf(heightStr, sizeof(heightStr), "%.1f", (double)height);
     display.setTextSize(3);
     centerText(heightStr, 35, 3);
     
     display.setTextSize(1);
-    centerText("Up/Down: Adjust | Both: Save", 56, 1);
-    
-  } else if (step == 2) {
-    // Step 3: Show results
-    float heightDiff = endHeight - startHeight;
-    float slitsPerMM = (heightDiff != 0) ? pulseCount / heightDiff : 0;
+    centerText(pointNumber > 2 ? "Both:Next Hold:Save" : "Both:Next", 56, 1);
     
+  } else {
+    // Show results: number of points and average scale
+    char title[12];
+    snprintf(title, sizeof(title), "%d POINTS", pointNumber);
     display.setTextSize(2);
-    centerText("CALIBRATED", 15, 2);
+    centerText(title, 15, 2);
     
     char resultStr[10];
     snprintf(resultStr, sizeof(resultStr), "%.1f", (double)slitsPerMM);
@@ -249,5 +437,27 @@ void HeightDisplay::showEncoderCalibrationMode(uint8_t step, float startHeight,
     centerText("slits/mm", 50, 1);
   }
   
-  display.display();
-}
\ No newline at end of file
+  flush();
+}
+
+void HeightDisplay::showCalibrationMove(uint8_t pointNumber) {
+  if (!present || overlayActive) {
+    return;
+  }
+  clearDisplay();
+  currentMode = CALIBRATION;
+
+  display.setTextSize(1);
+  centerText("ENCODER CAL", 2, 1);
+
+  char title[10];
+  snprintf(title, sizeof(title), "POINT %d", pointNumber);
+  display.setTextSize(2);
+  centerText(title, 15, 2);
+
+  display.setTextSize(1);
+  centerText("Hold Up/Dn to move", 38, 1);
+  centerText(pointNumber > 2 ? "Both:Set Hold:Save" : "Both:Set height", 56, 1);
+
+  flush();
+}
@@ -6,6 +6,21 @@
 #include <Arduino.h>
 #include <Wire.h>
 
+// SSD1306 status display.
+//
+// The panel is optional: if it does not answer on the bus, or an I2C transfer
+// times out, the display is marked absent and every call returns without
+// rendering or touching the bus. update() re-probes every REPROBE_INTERVAL_MS
+// and asks the owner to redraw once the panel is back. Wire runs with a
+// timeout, so a stuck bus costs at most I2C_TIMEOUT_US per wait.
+//
+// The height screen has a frame budget. showHeight() only records the value;
+// update() draws it at most every MOVING_FRAME_MS while the desk is driven
+// and every IDLE_FRAME_MS at rest. When only the number changed, just the
+// digit rows are sent (half the panel), so a move costs at most
+// 1000 / MOVING_FRAME_MS partial frames per second. Layout changes (start,
+// stop, direction, coming back from another screen) get a full frame in the
+// next moving slot.
 class HeightDisplay {
 public:
   enum DisplayMode {
@@ -21,14 +36,23 @@ public:
   void init();
   
   // Enhanced display methods
-  void showHeight(float heightMM, bool isMoving = false);
+  void showHeight(float heightMM, int8_t direction = 0); // Commanded motion: 1 up, -1 down, 0 stopped
   void showPresetMode(uint8_t presetNumber, float presetHeight);
   void showCalibrationMode(float currentHeight, bool showInstructions = false);
-  void showEncoderCalibrationMode(uint8_t step, float startHeight, float endHeight, long pulseCount);
-  void showStatusMessage(const char* message, bool isSuccess = true);
+  void showEncoderCalibrationMode(uint8_t pointNumber, float height, bool done, float slitsPerMM = 0.0f);
+  void showCalibrationMove(uint8_t pointNumber); // Drive the desk to reference point N
+  // Status messages are an overlay: other screens are not drawn until it expires
+  void showStatusMessage(const char* message, bool isSuccess = true, unsigned long durationMs = STATUS_DURATION_MS);
+  bool consumeRedrawRequest(); // True once after an overlay expired; the owner redraws its screen
   void showError(const char* errorMessage);
   void showBootScreen();
-  void update(); // Call regularly for animations
+  void update(); // Call every loop: overlay expiry, re-probing and height frames
+  bool isPresent() const;
+
+  // Power saving
+  void setDimmed(bool dimmed);
+  void setPanelOn(bool on);
+  bool isPanelOn() const;
   
   // Legacy compatibility method
   void showMessage(const char* message);
@@ -38,6 +62,7 @@ private:
   static const int SCREEN_HEIGHT = 64;
   static const int OLED_RESET = -1;
   static const int SCREEN_ADDRESS = 0x3C;
+  static const int MAX_MESSAGE_LENGTH = 20;
   
   // UI Layout constants for 128x64 display
   static const int HEADER_HEIGHT = 12;
@@ -45,23 +70,56 @@ private:
   static const int SECONDARY_CONTENT_Y = 40;
   static const int FOOTER_Y = 56;
   static const int MARGIN_X = 4;
+  static const int DIGITS_Y = 20; // Height digits, text size 3 (24 px)
+  static const uint8_t DIGITS_FIRST_PAGE = DIGITS_Y / 8;
+  static const uint8_t DIGITS_LAST_PAGE = (DIGITS_Y + 23) / 8;
   
   Adafruit_SSD1306 display;
   DisplayMode currentMode;
-  unsigned long lastUpdate;
-  bool animationToggle;
+  bool present;
+  unsigned long lastProbe;
+  bool dimmed;
+  bool panelOn;
+  bool overlayActive;
+  bool redrawRequested;
+  unsigned long overlayStart;
+  unsigned long overlayDuration;
+  bool overlaySuccess;
+  char overlayMessage[MAX_MESSAGE_LENGTH + 1];
+
+  // Height screen scheduling
+  float pendingHeight;
+  int8_t pendingDirection;
+  bool heightPending; // pendingHeight not on the panel yet
+  bool heightOnPanel; // Height layout is up, so a new value only needs the digits
+  int8_t shownDirection;
+  unsigned long lastFrame;
   
+  // Bus health
+  bool probe();
+  bool connect();
+  void flush();
+  bool sendPages(uint8_t firstPage, uint8_t lastPage); // Marks the panel lost on the first failed transfer
+  bool endTransfer();
+  void markLost();
+  void recoverBus();
+
   // UI rendering methods
+  void drawHeightFrame();
+  void drawOverlay();
   void clearDisplay();
   void centerText(const char* text, int y, int textSize = 1);
-  
-  // Animation helpers
-  void updateAnimations();
-  bool shouldAnimate();
-  
-  // Memory optimization
-  static const int MAX_MESSAGE_LENGTH = 20;
-  static const unsigned long ANIMATION_INTERVAL = 500; // 500ms
+
+  static const unsigned long MOVING_FRAME_MS = 100; // 10 frames/s while driven and for layout changes
+  static const unsigned long IDLE_FRAME_MS = 1000;  // 1 frame/s at rest (coasting, moved by hand)
+  static const unsigned long STATUS_DURATION_MS = 1500;
+  static const unsigned long REPROBE_INTERVAL_MS = 2000;
+  static const uint32_t I2C_TIMEOUT_US = 5000;
+  static const uint32_t I2C_FAST_CLOCK = 400000;     // Same clocks the driver uses around a frame
+  static const uint32_t I2C_STANDARD_CLOCK = 100000;
+  static const uint8_t I2C_CHUNK = 31;               // Wire buffer (32) minus the control byte
+  static const uint8_t CONTROL_COMMANDS = 0x00;      // SSD1306 control byte: command stream
+  static const uint8_t CONTROL_DATA = 0x40;          // SSD1306 control byte: display data
 };
 
 #endif // HEIGHTDISPLAY_H
\ No newline at end of file
@@ -0,0 +1,40 @@
+#include "LegSync.h"
+
+LegSync::LegSync(MotorControl& motorA, OpticalEncoder& encoderA, MotorControl& motorB, OpticalEncoder& encoderB)
+    : motorA(motorA), encoderA(encoderA), motorB(motorB), encoderB(encoderB), logic() {}
+
+void LegSync::init() {
+  motorB.init();
+  encoderB.init();
+  align();
+}
+
+void LegSync::align() {
+  encoderB.setPulseCount(encoderA.getPulseCount());
+  logic.align();
+}
+
+float LegSync::getSkewMM() const {
+  return (encoderA.getPulseCount() - encoderB.getPulseCount()) / encoderA.getSlitsPerMM();
+}
+
+LegSync::Status LegSync::update() {
+  // B is driven the same way as A, so its single-channel encoder counts the same way
+  encoderB.setDirection(encoderA.getDirection());
+  encoderB.update();
+
+  int8_t direction = motorA.getDirection();
+  LegSyncLogic::Output out =
+      logic.update(getSkewMM(), encoderA.getDirection(), direction, motorA.getDuty(), millis());
+
+  motorA.setTrim(out.trimA);
+  if (out.stop) {
+    motorA.stop();
+    motorB.stop();
+  } else if (direction == 0) {
+    motorB.stop();
+  } else {
+    motorB.driveRaw(direction > 0, out.dutyB);
+  }
+  return out.status;
+}
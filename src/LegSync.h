@@ -0,0 +1,45 @@
+#ifndef LEGSYNC_H
+#define LEGSYNC_H
+
+#include <Arduino.h>
+
+#include "LegSyncLogic.h"
+#include "MotorControl.h"
+#include "OpticalEncoder.h"
+
+// Cross-coupled drive for desks with two lifting columns (DUAL_LEG builds).
+//
+// Leg A is the desk's normal MotorControl/OpticalEncoder pair and keeps its ramp
+// and profile. Leg B follows A's duty and direction every loop. Whichever leg
+// is ahead is slowed in proportion to the skew (LegTrim), so sync holds even at
+// full duty, where the lagging leg cannot be sped up. Past FAULT_SKEW_MM the legs
+// are stopped (FAULT once) and the controller has to take the desk out of motion.
+// The next move levels the desk: only the lagging leg is driven, whichever
+// button is held, until the skew is back inside the deadband. If that makes no
+// progress for LEVEL_TIMEOUT_MS, FAULT is reported again. Both counts are
+// assumed equal when the desk is level: align() is called at boot, after
+// calibration and on demand.
+//
+// The decision itself is LegSyncLogic; this class reads the encoders and
+// applies its output to the motors.
+class LegSync {
+public:
+  typedef LegSyncLogic::Status Status;
+
+  LegSync(MotorControl& motorA, OpticalEncoder& encoderA, MotorControl& motorB, OpticalEncoder& encoderB);
+  void init();
+  Status update(); // Call after MotorControl::update()
+  void align();
+  float getSkewMM() const; // Positive when leg A is higher
+
+private:
+  static_assert(LegTrim::MAX_TRIM == MotorControl::MAX_DUTY, "LegTrim must saturate at full duty");
+
+  MotorControl& motorA;
+  OpticalEncoder& encoderA;
+  MotorControl& motorB;
+  OpticalEncoder& encoderB;
+  LegSyncLogic logic;
+};
+
+#endif // LEGSYNC_H
@@ -0,0 +1,91 @@
+#ifndef LEGSYNCLOGIC_H
+#define LEGSYNCLOGIC_H
+
+#include <math.h>
+#include <stdint.h>
+
+#include "LegTrim.h"
+
+// LegSync's per-loop decision: skew in, trims and leg B's duty out. Holds the
+// fault latch and the levelling progress timer. Kept free of Arduino and
+// hardware headers (time is passed in) so the native tests drive the real
+// decision against a simulated two-leg plant (test/test_legsync).
+class LegSyncLogic {
+public:
+  enum Status : uint8_t { IN_SYNC, LEVELLING, FAULT };
+
+  struct Output {
+    Status status;
+    bool stop;      // Stop both legs now
+    uint16_t trimA; // Duty taken off leg A
+    uint16_t dutyB; // Leg B's duty, driven the same way as leg A
+  };
+
+  LegSyncLogic() : levelling(false), bestSkewMM(0.0f), progressTime(0) {}
+
+  // The legs are level: clear the latch
+  void align() {
+    levelling = false;
+  }
+
+  // skewMM is positive when leg A is higher, countDirection the way the encoders
+  // count, driveDirection leg A's commanded direction (0 stopped) and dutyA its duty
+  Output update(float skewMM, int8_t countDirection, int8_t driveDirection, uint16_t dutyA, unsigned long nowMs) {
+    float absSkew = fabsf(skewMM);
+    if (!levelling && absSkew > FAULT_SKEW_MM) {
+      levelling = true;
+      bestSkewMM = absSkew;
+      progressTime = nowMs;
+      return output(FAULT, true, 0, 0);
+    }
+
+    if (driveDirection == 0) {
+      // Each move gets a fresh levelling window
+      bestSkewMM = absSkew;
+      progressTime = nowMs;
+      return output(levelling ? LEVELLING : IN_SYNC, false, 0, 0);
+    }
+
+    // Lead along the counting direction (= direction of travel); only the leader is held back
+    float lead = countDirection > 0 ? skewMM : -skewMM;
+
+    if (levelling && absSkew > LegTrim::DEADBAND_MM) {
+      if (absSkew < bestSkewMM - PROGRESS_MM) {
+        bestSkewMM = absSkew;
+        progressTime = nowMs;
+      } else if (nowMs - progressTime > LEVEL_TIMEOUT_MS) {
+        // The lagging leg is not catching up (blocked, or its encoder is dead)
+        return output(FAULT, true, 0, 0);
+      }
+      // Either direction works: the leader waits while the other leg closes the gap
+      if (lead > 0.0f) {
+        return output(LEVELLING, false, LegTrim::MAX_TRIM, dutyA);
+      }
+      return output(LEVELLING, false, 0, 0);
+    }
+
+    levelling = false;
+    uint16_t trimB = LegTrim::compute(-lead);
+    return output(IN_SYNC, false, LegTrim::compute(lead), dutyA > trimB ? dutyA - trimB : 0);
+  }
+
+  static constexpr float FAULT_SKEW_MM = 10.0f;
+  static constexpr float PROGRESS_MM = 0.2f;
+  static const unsigned long LEVEL_TIMEOUT_MS = 1000;
+
+private:
+  static Output output(Status status, bool stop, uint16_t trimA, uint16_t dutyB) {
+    Output out;
+    out.status = status;
+    out.stop = stop;
+    out.trimA = trimA;
+    out.dutyB = dutyB;
+    return out;
+  }
+
+  bool levelling;             // Skew went past FAULT_SKEW_MM and has not been levelled yet
+  float bestSkewMM;           // Smallest skew of the current levelling move
+  unsigned long progressTime; // When bestSkewMM last improved
+};
+
+#endif // LEGSYNCLOGIC_H
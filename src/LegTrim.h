@@ -0,0 +1,26 @@
+#ifndef LEGTRIM_H
+#define LEGTRIM_H
+
+#include <stdint.h>
+
+// Trim law for LegSync: the duty taken off the leading leg for a given lead.
+// Kept free of Arduino and hardware headers so the native tests can run it
+// against a simulated two-leg plant (test/test_legsync).
+struct LegTrim {
+  static constexpr float DEADBAND_MM = 0.5f;   // About the encoder resolution, no correction
+  static constexpr float TRIM_PER_MM = 100.0f; // Duty counts per mm of lead beyond the deadband
+  static const uint16_t MAX_TRIM = 400;        // MotorControl::MAX_DUTY, checked in LegSync
+
+  static uint16_t compute(float leadMM) {
+    if (leadMM <= DEADBAND_MM) {
+      return 0;
+    }
+    float trim = (leadMM - DEADBAND_MM) * TRIM_PER_MM;
+    if (trim >= MAX_TRIM) {
+      return MAX_TRIM;
+    }
+    return static_cast<uint16_t>(trim);
+  }
+};
+
+#endif // LEGTRIM_H
@@ -0,0 +1,41 @@
+#include "MemoryMonitor.h"
+
+// Linker and malloc symbols from avr-libc
+extern uint8_t _end;
+extern uint8_t __stack;
+extern char __heap_start;
+extern char* __brkval;
+
+static const uint8_t STACK_CANARY = 0xC5;
+
+// Runs from .init3: SP and r1 are set up, .data/.bss are not initialised yet and
+// nothing has been pushed, so the whole region can be painted.
+void paintStack() __attribute__((naked, used, section(".init3")));
+
+void paintStack() {
+  uint8_t* p = &_end;
+  while (p <= &__stack) {
+    *p = STACK_CANARY;
+    p++;
+  }
+}
+
+const uint8_t* MemoryMonitor::heapEnd() {
+  return reinterpret_cast<const uint8_t*>(__brkval != nullptr ? __brkval : &__heap_start);
+}
+
+uint16_t MemoryMonitor::getFreeMemory() {
+  const uint8_t* stackPointer = reinterpret_cast<const uint8_t*>(SP);
+  const uint8_t* heapTop = heapEnd();
+  return stackPointer > heapTop ? stackPointer - heapTop : 0;
+}
+
+uint16_t MemoryMonitor::getStackHighWater() {
+  const uint8_t* p = heapEnd();
+  uint16_t untouched = 0;
+  while (p <= &__stack && *p == STACK_CANARY) {
+    p++;
+    untouched++;
+  }
+  return untouched;
+}
@@ -0,0 +1,22 @@
+#ifndef MEMORYMONITOR_H
+#define MEMORYMONITOR_H
+
+#include <Arduino.h>
+
+// Free SRAM between the heap and the stack.
+//
+// Before constructors run, everything from the end of .bss up to RAMEND is
+// painted with a canary byte. The stack grows down into that region and the
+// heap (the SSD1306 frame buffer lives there) grows up into it, so the run of
+// untouched canary bytes above the heap top is the smallest gap the two have
+// ever had since boot.
+class MemoryMonitor {
+public:
+  static uint16_t getFreeMemory();     // Gap between heap top and stack pointer right now
+  static uint16_t getStackHighWater(); // Smallest gap seen since boot
+
+private:
+  static const uint8_t* heapEnd();
+};
+
+#endif // MEMORYMONITOR_H
@@ -0,0 +1,137 @@
+#include "MotorCharacterizer.h"
+
+MotorCharacterizer::MotorCharacterizer(MotorControl& motor, OpticalEncoder& encoder, EndStop& endStop)
+    : motor(motor), encoder(encoder), endStop(endStop), phase(IDLE), level(0), measuring(false), phaseStart(0),
+      windowStartCount(0) {}
+
+void MotorCharacterizer::start() {
+  phase = SWEEP_FORWARD;
+  samples[0] = 0;
+  beginLevel(1);
+}
+
+void MotorCharacterizer::abort() {
+  motor.stop();
+  phase = IDLE;
+}
+
+bool MotorCharacterizer::isActive() const {
+  return phase != IDLE;
+}
+
+MotorCharacterizer::Result MotorCharacterizer::update() {
+  if (phase == IDLE) {
+    return FAILED;
+  }
+
+  if (endStop.isTriggered()) {
+    abort();
+    return FAILED;
+  }
+
+  unsigned long now = millis();
+
+  if (phase == PAUSE) {
+    if (now - phaseStart >= PAUSE_MS) {
+      phase = SWEEP_BACKWARD;
+      beginLevel(1);
+    }
+    return RUNNING;
+  }
+
+  if (!measuring) {
+    if (now - phaseStart >= LEVEL_SETTLE_MS) {
+      windowStartCount = encoder.getPulseCount();
+      measuring = true;
+    }
+    return RUNNING;
+  }
+
+  if (now - phaseStart < LEVEL_SETTLE_MS + LEVEL_WINDOW_MS) {
+    return RUNNING;
+  }
+
+  // Pulses travelled, whichever way the sweep is counting
+  long pulses = labs(encoder.getPulseCount() - windowStartCount);
+  samples[level] = (pulses > 0xFFFF) ? 0xFFFF : static_cast<uint16_t>(pulses);
+
+  if (level < SWEEP_STEPS) {
+    beginLevel(level + 1);
+    return RUNNING;
+  }
+
+  motor.stop();
+  MotorProfile& profile = motor.getProfile();
+
+  if (phase == SWEEP_FORWARD) {
+    if (!buildTable(profile.forwardDuty)) {
+      phase = IDLE;
+      return FAILED;
+    }
+    phase = PAUSE;
+    phaseStart = now;
+    return RUNNING;
+  }
+
+  phase = IDLE;
+  if (!buildTable(profile.backwardDuty)) {
+    return FAILED;
+  }
+  profile.marker = MotorProfile::VALID_MARKER;
+  return DONE;
+}
+
+void MotorCharacterizer::beginLevel(uint8_t newLevel) {
+  level = newLevel;
+  measuring = false;
+  phaseStart = millis();
+  // The single-channel encoder only counts the right way if it is told the direction
+  encoder.setDirection(phase == SWEEP_FORWARD ? 1 : -1);
+  motor.driveRaw(phase == SWEEP_FORWARD, levelDuty(level));
+}
+
+bool MotorCharacterizer::buildTable(uint16_t* table) {
+  uint8_t firstMoving = 0;
+  for (uint8_t i = 1; i <= SWEEP_STEPS; i++) {
+    if (samples[i] >= MIN_MOVING_PULSES) {
+      firstMoving = i;
+      break;
+    }
+  }
+
+  uint16_t topSpeed = samples[SWEEP_STEPS];
+  if (firstMoving == 0 || topSpeed < MIN_MOVING_PULSES * 4) {
+    return false;
+  }
+
+  const uint8_t last = MotorProfile::PROFILE_POINTS - 1;
+  table[0] = levelDuty(firstMoving);
+  table[last] = MotorControl::MAX_DUTY;
+
+  // Place each breakpoint where the measured speed first reaches its share of top speed
+  uint8_t i = firstMoving;
+  for (uint8_t p = 1; p < last; p++) {
+    uint16_t target = static_cast<uint32_t>(topSpeed) * p / last;
+    while (i < SWEEP_STEPS && samples[i] < target) {
+      i++;
+    }
+
+    uint16_t duty = levelDuty(i);
+    if (i > firstMoving && samples[i] > samples[i - 1]) {
+      // Interpolate between the two levels bracketing the target speed
+      uint16_t below = samples[i - 1];
+      uint16_t step = levelDuty(i) - levelDuty(i - 1);
+      uint16_t over = (target > below) ? target - below : 0;
+      duty = levelDuty(i - 1) + static_cast<uint32_t>(step) * over / (samples[i] - below);
+    }
+
+    // Keep the table monotonic even with noisy samples
+    table[p] = (duty < table[p - 1]) ? table[p - 1] : duty;
+  }
+
+  return true;
+}
+
+uint16_t MotorCharacterizer::levelDuty(uint8_t level) {
+  return static_cast<uint32_t>(MotorControl::MAX_DUTY) * level / SWEEP_STEPS;
+}
@@ -0,0 +1,51 @@
+#ifndef MOTORCHARACTERIZER_H
+#define MOTORCHARACTERIZER_H
+
+#include "EndStop.h"
+#include "MotorControl.h"
+#include "OpticalEncoder.h"
+
+// Self-characterisation of the lift motor.
+//
+// Sweeps raw duty upwards in SWEEP_STEPS levels, first driving up then down, and
+// measures encoder pulses at each level. From that it builds the MotorProfile
+// speed -> duty tables: the first level that moves becomes entry 0 (deadband edge)
+// and the rest are placed so equal speed steps give equal measured velocity.
+// Runs non-blocking from update(); the endstop aborts the sweep.
+class MotorCharacterizer {
+public:
+  enum Result { RUNNING, DONE, FAILED };
+
+  MotorCharacterizer(MotorControl& motor, OpticalEncoder& encoder, EndStop& endStop);
+
+  void start();
+  void abort();
+  Result update();
+  bool isActive() const;
+
+private:
+  enum Phase { SWEEP_FORWARD, PAUSE, SWEEP_BACKWARD, IDLE };
+
+  void beginLevel(uint8_t level);
+  bool buildTable(uint16_t* table);
+  static uint16_t levelDuty(uint8_t level);
+
+  MotorControl& motor;
+  OpticalEncoder& encoder;
+  EndStop& endStop;
+
+  static const uint8_t SWEEP_STEPS = 16;
+  static const unsigned long LEVEL_SETTLE_MS = 80;  // Let the motor accelerate before measuring
+  static const unsigned long LEVEL_WINDOW_MS = 120; // Measurement window per level
+  static const unsigned long PAUSE_MS = 500;        // Standstill between directions
+  static const uint16_t MIN_MOVING_PULSES = 2;      // Below this the desk counts as stalled
+
+  Phase phase;
+  uint8_t level;
+  bool measuring;
+  unsigned long phaseStart;
+  long windowStartCount;
+  uint16_t samples[SWEEP_STEPS + 1]; // Pulses per measurement window, index = level
+};
+
+#endif // MOTORCHARACTERIZER_H
@@ -1,13 +1,44 @@
 #include "MotorControl.h"
 
-MotorControl::MotorControl(uint8_t forwardPin, uint8_t backwardPin)
-    : forwardPin(forwardPin), backwardPin(backwardPin), currentSpeed(0), targetSpeed(0), lastRampTime(0),
-      isMovingForward(false), isMovingBackward(false) {}
+#include "TraceRecorder.h"
+
+MotorControl::MotorControl(uint8_t channel)
+    : channel(channel), tracedCommand(0), rawMode(false), trim(0), currentSpeed(0),
+      targetSpeed(0), currentDuty(0), lastRampTime(0), isMovingForward(false), isMovingBackward(false) {
+  profile.marker = 0;
+}
 
 void MotorControl::init() {
+#ifdef DUAL_LEG
+  if (channel != 0) {
+    FastPin<LEG_B_PWM_PIN>::setOutput();
+    FastPin<LEG_B_FORWARD_PIN>::setOutput();
+    FastPin<LEG_B_BACKWARD_PIN>::setOutput();
+
+    // Phase-correct PWM, TOP = 0xFF (mode 1), no prescaler, non-inverting on OC2A
+    TCCR2B = 0;
+    TCCR2A = _BV(COM2A1) | _BV(WGM20);
+    OCR2A = 0;
+    TCNT2 = 0;
+    TCCR2B = _BV(CS20);
+
+    stop();
+    return;
+  }
+#endif
+
   // Set up the motor control pins as outputs
-  pinMode(forwardPin, OUTPUT);
-  pinMode(backwardPin, OUTPUT);
+  FastPin<MOTOR_FORWARD_PIN>::setOutput();
+  FastPin<MOTOR_BACKWARD_PIN>::setOutput();
+
+  // Phase-correct PWM, TOP = ICR1 (mode 10), no prescaler, non-inverting on OC1A/OC1B
+  TCCR1B = 0;
+  TCCR1A = _BV(COM1A1) | _BV(COM1B1) | _BV(WGM11);
+  ICR1 = TIMER1_TOP;
+  OCR1A = 0;
+  OCR1B = 0;
+  TCNT1 = 0;
+  TCCR1B = _BV(WGM13) | _BV(CS10);
 
   // Ensure motors are stopped at initialization
   stop();
@@ -15,52 +46,144 @@ void MotorControl::init() {
 
 void MotorControl::forward(uint8_t speed) {
   targetSpeed = speed;
+  rawMode = false;
   isMovingForward = true;
   isMovingBackward = false;
+  traceCommand();
 }
 
 void MotorControl::backward(uint8_t speed) {
   targetSpeed = speed;
+  rawMode = false;
   isMovingForward = false;
   isMovingBackward = true;
+  traceCommand();
 }
 
 void MotorControl::stop() {
   targetSpeed = 0;
+  rawMode = false;
   isMovingForward = false;
   isMovingBackward = false;
   currentSpeed = 0;
-  analogWrite(forwardPin, 0);
-  analogWrite(backwardPin, 0);
+  currentDuty = 0;
+  writeOutputs();
+  traceCommand();
 }
 
 void MotorControl::setSpeed(uint8_t speed) {
   targetSpeed = speed;
+  traceCommand();
 }
 
 uint8_t MotorControl::getSpeed() const {
   return currentSpeed;
 }
 
+void MotorControl::driveRaw(bool forward, uint16_t duty) {
+  rawMode = true;
+  isMovingForward = forward;
+  isMovingBackward = !forward;
+  currentDuty = (duty > MAX_DUTY) ? static_cast<uint16_t>(MAX_DUTY) : duty;
+  writeOutputs();
+}
+
+uint16_t MotorControl::getDuty() const {
+  return currentDuty;
+}
+
+int8_t MotorControl::getDirection() const {
+  if (isMovingForward) {
+    return 1;
+  }
+  return isMovingBackward ? -1 : 0;
+}
+
+void MotorControl::setTrim(uint16_t reduction) {
+  if (reduction == trim) {
+    return;
+  }
+  trim = reduction;
+  writeOutputs();
+}
+
+void MotorControl::setProfile(const MotorProfile& newProfile) {
+  profile = newProfile;
+}
+
+MotorProfile& MotorControl::getProfile() {
+  return profile;
+}
+
 void MotorControl::update() {
   unsigned long currentTime = millis();
-  if (currentTime - lastRampTime >= 20) { // Update every 20ms
-    lastRampTime = currentTime;
+  unsigned long elapsed = currentTime - lastRampTime;
+  if (elapsed >= RAMP_INTERVAL_MS) {
+    // Catch up on missed ticks so the ramp rate does not depend on loop period
+    unsigned long ticks = elapsed / RAMP_INTERVAL_MS;
+    lastRampTime += ticks * RAMP_INTERVAL_MS;
+    uint8_t step = (ticks * RAMP_STEP > MAX_SPEED) ? MAX_SPEED : ticks * RAMP_STEP;
 
-    if (currentSpeed != targetSpeed) {
+    if (!rawMode && currentSpeed != targetSpeed) {
       if (currentSpeed < targetSpeed) {
-        currentSpeed = min(currentSpeed + RAMP_STEP, targetSpeed);
+        currentSpeed = (targetSpeed - currentSpeed > step) ? currentSpeed + step : targetSpeed;
       } else {
-        currentSpeed = max(currentSpeed - RAMP_STEP, targetSpeed);
-      }
-
-      if (isMovingForward) {
-        analogWrite(backwardPin, 0);
-        analogWrite(forwardPin, currentSpeed);
-      } else if (isMovingBackward) {
-        analogWrite(forwardPin, 0);
-        analogWrite(backwardPin, currentSpeed);
+        currentSpeed = (currentSpeed - targetSpeed > step) ? currentSpeed - step : targetSpeed;
       }
+      currentDuty = speedToDuty(currentSpeed);
+      writeOutputs();
     }
   }
 }
+
+void MotorControl::writeOutputs() {
+  uint16_t duty = currentDuty > trim ? currentDuty - trim : 0;
+
+#ifdef DUAL_LEG
+  if (channel != 0) {
+    FastPin<LEG_B_FORWARD_PIN>::write(isMovingForward);
+    FastPin<LEG_B_BACKWARD_PIN>::write(isMovingBackward);
+    OCR2A = (isMovingForward || isMovingBackward) ? static_cast<uint8_t>((duty * 51u) / 80u) : 0; // 255 / 400
+    return;
+  }
+#endif
+
+  ForwardPwm::write(isMovingForward ? duty : 0);
+  BackwardPwm::write(isMovingBackward ? duty : 0);
+}
+
+void MotorControl::traceCommand() {
+  // Commanded target and direction; the ramp follows from them. Channel 1 only mirrors channel 0.
+  if (channel != 0) {
+    return;
+  }
+  int8_t command = 0;
+  if (isMovingForward) {
+    command = static_cast<int8_t>(targetSpeed >> 3);
+  } else if (isMovingBackward) {
+    command = -static_cast<int8_t>(targetSpeed >> 3);
+  }
+  if (command != tracedCommand) {
+    tracedCommand = command;
+    TraceRecorder::recordLatest(TraceRecorder::MOTOR, command);
+  }
+}
+
+uint16_t MotorControl::speedToDuty(uint8_t speed) const {
+  if (speed == 0) {
+    return 0;
+  }
+  if (!profile.isValid()) {
+    return (static_cast<uint32_t>(speed) * MAX_DUTY + MAX_SPEED / 2) / MAX_SPEED;
+  }
+
+  // 255 speed units spread over PROFILE_POINTS - 1 = 8 segments of 32
+  const uint16_t* table = isMovingBackward ? profile.backwardDuty : profile.forwardDuty;
+  if (speed == MAX_SPEED) {
+    return table[MotorProfile::PROFILE_POINTS - 1];
+  }
+  uint8_t index = speed >> 5;
+  uint8_t frac = speed & 0x1F;
+  int16_t span = static_cast<int16_t>(table[index + 1]) - static_cast<int16_t>(table[index]);
+  return table[index] + ((static_cast<int32_t>(span) * frac) >> 5);
+}
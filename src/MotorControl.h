@@ -3,9 +3,46 @@
 
 #include <Arduino.h>
 
+#include "FastPin.h"
+#include "Pins.h"
+
+// Learned speed -> duty mapping, one table per direction.
+// Entry 0 is the smallest duty that makes the desk move (the deadband edge),
+// entry PROFILE_POINTS - 1 is full duty; speeds in between are interpolated.
+struct MotorProfile {
+  static const uint8_t PROFILE_POINTS = 9;
+  static const uint8_t VALID_MARKER = 0xA5;
+
+  uint8_t marker;
+  uint16_t forwardDuty[PROFILE_POINTS];
+  uint16_t backwardDuty[PROFILE_POINTS];
+
+  bool isValid() const {
+    return marker == VALID_MARKER;
+  }
+};
+
+// Motor driver on Timer1 (D9 = OC1A, D10 = OC1B).
+//
+// Timer1 runs phase-correct PWM with ICR1 as TOP, giving an inaudible ~20 kHz
+// carrier and TIMER1_TOP + 1 duty steps instead of analogWrite's 490 Hz / 256 steps.
+// Duty is written straight to OCR1A/OCR1B, so the setters are a couple of stores.
+//
+// Note: this takes Timer1 away from everything else. Do not use the Servo library,
+// and do not count encoder pulses with Timer1's external clock input (T1 = D5, the
+// encoder pin) - the encoder has to stay on polling or a pin interrupt.
+// MOTOR_FORWARD_PIN/MOTOR_BACKWARD_PIN must be D9/D10; this is checked at compile time.
+//
+// With DUAL_LEG, channel 1 drives the second column's bridge instead: Timer2
+// phase-correct PWM (~31 kHz, 8 bit) on LEG_B_PWM_PIN as the enable and two
+// direction lines. Duty is still given in Timer1 counts and scaled.
+//
+// forward()/backward() take a speed (0..255 of the desk's measured top speed), not
+// a raw duty. With a learned MotorProfile, any non-zero speed starts just above the
+// deadband; without one the mapping is linear.
 class MotorControl {
 public:
-  MotorControl(uint8_t forwardPin, uint8_t backwardPin);
+  MotorControl(uint8_t channel = 0);
   void init();
   void forward(uint8_t speed);
   void backward(uint8_t speed);
@@ -14,19 +51,46 @@ public:
   uint8_t getSpeed() const;
   void update(); // Call this regularly to handle ramping
 
+  // Raw duty in Timer1 counts (0..MAX_DUTY), bypassing ramp and profile.
+  // Used by motor characterisation.
+  void driveRaw(bool forward, uint16_t duty);
+  uint16_t getDuty() const;
+  int8_t getDirection() const; // 1 forward, -1 backward, 0 stopped
+
+  // Duty taken off the output without touching the ramp, for leg synchronisation
+  void setTrim(uint16_t reduction);
+
+  // Speed -> duty linearisation
+  void setProfile(const MotorProfile& profile);
+  MotorProfile& getProfile();
+
+  static const uint16_t TIMER1_TOP = 400; // 16 MHz / (2 * 400) = 20 kHz
+  static const uint16_t MAX_DUTY = TIMER1_TOP;
+
 private:
-  uint8_t forwardPin;
-  uint8_t backwardPin;
+  void writeOutputs();
+  void traceCommand();
+  uint16_t speedToDuty(uint8_t speed) const;
+
+  typedef Timer1Pwm<MOTOR_FORWARD_PIN> ForwardPwm;
+  typedef Timer1Pwm<MOTOR_BACKWARD_PIN> BackwardPwm;
+
+  uint8_t channel;
+  int8_t tracedCommand; // Last MOTOR entry, so only changes are traced
+  bool rawMode;
+  uint16_t trim;
   uint8_t currentSpeed;
   uint8_t targetSpeed;
+  uint16_t currentDuty;
   unsigned long lastRampTime;
   bool isMovingForward;
   bool isMovingBackward;
+  MotorProfile profile;
 
   static const uint8_t MIN_SPEED = 0;
   static const uint8_t MAX_SPEED = 255;
-  static const unsigned long RAMP_TIME_MS = 500; // Reduced from 1000ms to 500ms
-  static const uint8_t RAMP_STEP = 5;           // Increased from 5 to 10 for faster ramping
+  static const unsigned long RAMP_INTERVAL_MS = 4; // Ramp tick
+  static const uint8_t RAMP_STEP = 1;              // Speed units per tick (0 -> full in ~1 s)
 };
 
 #endif // MOTORCONTROL_H
@@ -0,0 +1,197 @@
+#include "MoveStats.h"
+#include <avr/pgmspace.h>
+
+// Upper bin edges; the last bin takes everything above
+static const int16_t STOP_ERROR_EDGES[] PROGMEM = {-20, -10, -3, 3, 10, 20}; // 0.1 mm, target moves only
+static const int16_t LOOP_EDGES[] PROGMEM = {12, 16, 25, 50, 100};           // ms
+static const int16_t SPEED_EDGES[] PROGMEM = {5, 10, 15, 20, 25, 30, 35};    // mm/s
+
+MoveStats::MoveStats()
+    : historyHead(0), historyCount(0), active(false), startTime(0), windowStart(0), windowHeight(0.0f),
+      cutHeight(0.0f), dumping(false), dumpLine(0) {
+  memset(reasonCounts, 0, sizeof(reasonCounts));
+  memset(stopError, 0, sizeof(stopError));
+  memset(loopTime, 0, sizeof(loopTime));
+  memset(peakSpeed, 0, sizeof(peakSpeed));
+}
+
+int16_t MoveStats::toTenths(float mm) {
+  float tenths = mm * 10.0f;
+  if (tenths > 32767.0f) {
+    return 32767;
+  }
+  if (tenths < -32767.0f) {
+    return -32767;
+  }
+  return static_cast<int16_t>(tenths + (tenths >= 0.0f ? 0.5f : -0.5f));
+}
+
+void MoveStats::begin(float startHeight, bool hasTarget, float target) {
+  if (active) {
+    // Restarted before the previous move settled
+    finish(startHeight);
+  }
+
+  active = true;
+  startTime = millis();
+  windowStart = startTime;
+  windowHeight = startHeight;
+  cutHeight = startHeight;
+
+  current.startHeight = toTenths(startHeight);
+  current.endHeight = current.startHeight;
+  current.target = NO_TARGET;
+  if (hasTarget) {
+    current.target = toTenths(target);
+  }
+  current.durationMs = 0;
+  current.peakSpeed = 0;
+  current.overshoot = 0;
+  current.stopDistance = 0;
+  current.maxLoopMs = 0;
+  current.reason = OTHER;
+}
+
+void MoveStats::update(float height, uint8_t loopMs) {
+  if (!active) {
+    return;
+  }
+  if (loopMs > current.maxLoopMs) {
+    current.maxLoopMs = loopMs;
+  }
+
+  // Speed over a window so single encoder steps do not read as spikes
+  unsigned long now = millis();
+  if (now - windowStart >= SPEED_WINDOW_MS) {
+    float speed = fabs(height - windowHeight) * 1000.0f / (now - windowStart);
+    uint8_t rounded = speed >= 255.0f ? 255 : static_cast<uint8_t>(speed + 0.5f);
+    if (rounded > current.peakSpeed) {
+      current.peakSpeed = rounded;
+    }
+    windowStart = now;
+    windowHeight = height;
+  }
+}
+
+void MoveStats::endDrive(Reason reason, float height) {
+  if (!active) {
+    return;
+  }
+  current.reason = reason;
+  cutHeight = height;
+}
+
+void MoveStats::finish(float height) {
+  if (!active) {
+    return;
+  }
+  active = false;
+
+  unsigned long duration = millis() - startTime;
+  current.durationMs = duration > 0xFFFF ? 0xFFFF : static_cast<uint16_t>(duration);
+  current.endHeight = toTenths(height);
+
+  int16_t coast = abs(current.endHeight - toTenths(cutHeight));
+  current.stopDistance = coast > 255 ? 255 : static_cast<uint8_t>(coast);
+
+  if (current.target != NO_TARGET) {
+    int16_t error = current.endHeight - current.target;
+    int16_t past = current.endHeight >= current.startHeight ? error : -error;
+    current.overshoot = static_cast<int8_t>(past > 127 ? 127 : (past < -127 ? -127 : past));
+    count(stopError, bin(error, STOP_ERROR_EDGES, ERROR_BINS - 1));
+  }
+  count(reasonCounts, current.reason);
+  count(loopTime, bin(current.maxLoopMs, LOOP_EDGES, LOOP_BINS - 1));
+  count(peakSpeed, bin(current.peakSpeed, SPEED_EDGES, SPEED_BINS - 1));
+
+  history[historyHead] = current;
+  historyHead = (historyHead + 1) % HISTORY;
+  if (historyCount < HISTORY) {
+    historyCount++;
+  }
+}
+
+bool MoveStats::isActive() const {
+  return active;
+}
+
+uint8_t MoveStats::bin(int16_t value, const int16_t* upperEdges, uint8_t edges) {
+  uint8_t i = 0;
+  while (i < edges && value >= static_cast<int16_t>(pgm_read_word(&upperEdges[i]))) {
+    i++;
+  }
+  return i;
+}
+
+void MoveStats::count(uint16_t* histogram, uint8_t index) {
+  if (histogram[index] != 0xFFFF) {
+    histogram[index]++;
+  }
+}
+
+void MoveStats::startDump() {
+  dumping = true;
+  dumpLine = 0;
+}
+
+bool MoveStats::dumpStep(HardwareSerial& out) {
+  // One line per call at most, and only if it fits in the transmit buffer
+  if (!dumping || out.availableForWrite() < MAX_LINE) {
+    return dumping;
+  }
+
+  if (dumpLine < historyCount) {
+    const MoveRecord& move = history[(historyHead + HISTORY - historyCount + dumpLine) % HISTORY];
+    out.print(F("MOVE,"));
+    out.print(move.startHeight);
+    out.print(',');
+    out.print(move.endHeight);
+    out.print(',');
+    if (move.target != NO_TARGET) {
+      out.print(move.target);
+    }
+    out.print(',');
+    out.print(move.durationMs);
+    out.print(',');
+    out.print(move.peakSpeed);
+    out.print(',');
+    out.print(move.overshoot);
+    out.print(',');
+    out.print(move.stopDistance);
+    out.print(',');
+    out.print(move.maxLoopMs);
+    out.print(',');
+    out.println(move.reason);
+  } else {
+    switch (dumpLine - historyCount) {
+    case 0:
+      printHistogram(out, 'R', reasonCounts, OTHER + 1);
+      break;
+    case 1:
+      printHistogram(out, 'E', stopError, ERROR_BINS);
+      break;
+    case 2:
+      printHistogram(out, 'L', loopTime, LOOP_BINS);
+      break;
+    case 3:
+      printHistogram(out, 'S', peakSpeed, SPEED_BINS);
+      break;
+    default:
+      out.println(F("END"));
+      dumping = false;
+      return false;
+    }
+  }
+  dumpLine++;
+  return true;
+}
+
+void MoveStats::printHistogram(HardwareSerial& out, char id, const uint16_t* histogram, uint8_t bins) {
+  out.print(F("HIST,"));
+  out.print(id);
+  for (uint8_t i = 0; i < bins; i++) {
+    out.print(',');
+    out.print(histogram[i]);
+  }
+  out.println();
+}
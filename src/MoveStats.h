@@ -0,0 +1,76 @@
+#ifndef MOVESTATS_H
+#define MOVESTATS_H
+
+#include <Arduino.h>
+
+// One completed move, heights in 0.1 mm
+struct MoveRecord {
+  int16_t startHeight;
+  int16_t endHeight; // After coasting to a stop
+  int16_t target;    // NO_TARGET for manual moves
+  uint16_t durationMs; // Start to settled
+  uint8_t peakSpeed;   // mm/s
+  int8_t overshoot;    // Settled height past the target, along the direction of travel (clamped)
+  uint8_t stopDistance; // Coast after the motor was cut (clamped)
+  uint8_t maxLoopMs;
+  uint8_t reason; // MoveStats::Reason
+};
+
+// Per-move profiler: the last HISTORY moves plus histograms over all moves
+// since power-on, for tuning speeds and braking across desks.
+//
+// begin() when the motor starts, update() every loop while a move is active,
+// endDrive() when the motor is cut and finish() once the desk has coasted to a
+// stop. The dump is streamed a line at a time like the input trace, so it
+// never blocks the loop.
+class MoveStats {
+public:
+  enum Reason : uint8_t { RELEASED, TARGET, LIMIT, ENDSTOP, STALL, CANCELLED, FAULT, OTHER };
+  static const int16_t NO_TARGET = INT16_MIN;
+
+  MoveStats();
+  void begin(float startHeight, bool hasTarget, float target);
+  void update(float height, uint8_t loopMs);
+  void endDrive(Reason reason, float height);
+  void finish(float height);
+  bool isActive() const;
+
+  void startDump();
+  bool dumpStep(HardwareSerial& out); // False once the dump is complete
+
+private:
+  static int16_t toTenths(float mm);
+  static uint8_t bin(int16_t value, const int16_t* upperEdges, uint8_t edges); // Edges in PROGMEM
+  static void count(uint16_t* histogram, uint8_t index);
+  void printHistogram(HardwareSerial& out, char id, const uint16_t* histogram, uint8_t bins);
+
+  static const uint8_t HISTORY = 8;
+  static const uint16_t SPEED_WINDOW_MS = 100;
+  static const uint8_t MAX_LINE = 60;
+
+  MoveRecord history[HISTORY];
+  uint8_t historyHead;
+  uint8_t historyCount;
+
+  // Move in progress
+  bool active;
+  MoveRecord current;
+  unsigned long startTime;
+  unsigned long windowStart;
+  float windowHeight;
+  float cutHeight;
+
+  // Histograms (bin edges in MoveStats.cpp)
+  static const uint8_t ERROR_BINS = 7;
+  static const uint8_t LOOP_BINS = 6;
+  static const uint8_t SPEED_BINS = 8;
+  uint16_t reasonCounts[OTHER + 1];
+  uint16_t stopError[ERROR_BINS];
+  uint16_t loopTime[LOOP_BINS];
+  uint16_t peakSpeed[SPEED_BINS];
+
+  bool dumping;
+  uint8_t dumpLine;
+};
+
+#endif // MOVESTATS_H
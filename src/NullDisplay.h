@@ -0,0 +1,32 @@
+#ifndef NULLDISPLAY_H
+#define NULLDISPLAY_H
+
+#include <Arduino.h>
+
+// Display policy for builds without a panel (NO_DISPLAY). Same interface as
+// HeightDisplay with empty inline bodies, so every screen call compiles away
+// and neither Wire nor the SSD1306 driver is linked in.
+class NullDisplay {
+public:
+  void init() {}
+  void showHeight(float /*heightMM*/, int8_t /*direction*/ = 0) {}
+  void showPresetMode(uint8_t /*presetNumber*/, float /*presetHeight*/) {}
+  void showEncoderCalibrationMode(uint8_t /*pointNumber*/, float /*height*/, bool /*done*/,
+                                  float /*slitsPerMM*/ = 0.0f) {}
+  void showCalibrationMove(uint8_t /*pointNumber*/) {}
+  void showStatusMessage(const char* /*message*/, bool /*isSuccess*/ = true) {}
+  void update() {}
+
+  bool consumeRedrawRequest() {
+    return false;
+  }
+
+  void setDimmed(bool /*dimmed*/) {}
+  void setPanelOn(bool /*on*/) {}
+
+  bool isPanelOn() const {
+    return true; // Nothing to switch back on
+  }
+};
+
+#endif // NULLDISPLAY_H
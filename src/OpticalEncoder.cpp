@@ -1,61 +1,344 @@
 #include "OpticalEncoder.h"
+#include <util/atomic.h>
 
-OpticalEncoder::OpticalEncoder(uint8_t sensorPin, float slitsPerMM)
-    : sensorPin(sensorPin), 
+#include "TraceRecorder.h"
+
+OpticalEncoder* OpticalEncoder::instances[2] = {nullptr, nullptr};
+
+// Pin-change groups also carry the wake-up buttons; handlePinChange() ignores
+// changes on other pins because the sensor level is unchanged
+ISR(PCINT0_vect) {
+  OpticalEncoder::onPinChange(1);
+}
+
+#ifdef ENCODER_USE_COMPARATOR
+EMPTY_INTERRUPT(PCINT2_vect); // Wake-up only
+
+ISR(ANALOG_COMP_vect) {
+  OpticalEncoder::onPinChange(0);
+}
+#else
+ISR(PCINT2_vect) {
+  OpticalEncoder::onPinChange(0);
+}
+#endif
+
+OpticalEncoder::OpticalEncoder(float slitsPerMM, uint8_t channel)
+    : channel(channel),
       slitsPerMM(slitsPerMM),
+      maxSpeed(MAX_SPEED_MM_PER_S),
+      minLevelMicros(0),
       pulseCount(0),
+      direction(1),
       lastSensorState(LOW),
-      lastPulseTime(0) {}
+      filteredState(LOW),
+      levelStartMicros(0),
+      lastPulseTime(0),
+      lastEdgeMicros(0),
+      slitPeriodMicros(0),
+      rejectedEdges(0),
+      estimateCount(0),
+      subSlit(0.0f) {
+  heightTable.marker = 0;
+  updateMinLevel();
+}
 
 void OpticalEncoder::init() {
-  pinMode(sensorPin, INPUT_PULLUP); // Use pullup for optical sensor
-  lastSensorState = digitalRead(sensorPin);
-  pulseCount = 0;
-  lastPulseTime = millis();
-}
+  uint8_t pin = getPin();
+  pinMode(pin, INPUT_PULLUP); // Use pullup for optical sensor
+#ifdef ENCODER_USE_COMPARATOR
+  if (channel == 0) {
+    FastPin<ENCODER_THRESHOLD_PIN>::setInput();
+    ADCSRB &= ~_BV(ACME); // Negative input is AIN1
+    ACSR = _BV(ACIE);     // Comparator on, interrupt on every output toggle
+  }
+#endif
 
-void OpticalEncoder::update() {
-  int currentState = digitalRead(sensorPin);
-  
-  // Detect rising edge (light -> dark transition as slit passes)
-  if (currentState == LOW && lastSensorState == HIGH) {
-    pulseCount++;
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    lastSensorState = readSensor();
+    filteredState = lastSensorState;
+    levelStartMicros = micros();
+    pulseCount = 0;
     lastPulseTime = millis();
+    slitPeriodMicros = 0;
+  }
+  estimateCount = 0;
+  subSlit = 0.0f;
+
+  instances[channel] = this;
+#ifdef ENCODER_USE_COMPARATOR
+  if (channel == 0) {
+    return;
+  }
+#endif
+  *digitalPinToPCMSK(pin) |= _BV(digitalPinToPCMSKbit(pin));
+  PCICR |= _BV(digitalPinToPCICRbit(pin));
+}
+
+void OpticalEncoder::onPinChange(uint8_t channel) {
+  if (instances[channel] != nullptr) {
+    instances[channel]->handlePinChange();
+  }
+}
+
+void OpticalEncoder::handlePinChange() {
+  bool currentState = readSensor();
+  if (currentState == lastSensorState) {
+    return; // Another pin in the same group
+  }
+
+  // The level that just ended either lasted long enough to be real, or was a glitch
+  unsigned long now = micros();
+  confirmLevel(now);
+  if (lastSensorState != filteredState) {
+    // Shorter than the desk can produce: the confirmed level simply continues
+    rejectedEdges++;
+    TraceRecorder::record(TraceRecorder::GLITCH, channel);
   }
-  
+
   lastSensorState = currentState;
+  levelStartMicros = now;
+}
+
+void OpticalEncoder::confirmLevel(unsigned long now) {
+  if (lastSensorState == filteredState || now - levelStartMicros < minLevelMicros) {
+    return;
+  }
+  filteredState = lastSensorState;
+
+  // Light -> dark: a slit, timed from where its LOW level began
+  if (filteredState == LOW) {
+    bool moving = isMoving();
+    pulseCount += direction;
+    TraceRecorder::recordEdge(channel, direction);
+    // A period is only meaningful if the previous slit was part of the same run
+    slitPeriodMicros = moving ? levelStartMicros - lastEdgeMicros : 0;
+    lastEdgeMicros = levelStartMicros;
+    lastPulseTime = millis();
+  }
+}
+
+void OpticalEncoder::update() {
+  long count;
+  unsigned long edgeMicros;
+  unsigned long period;
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    confirmLevel(micros()); // Desk stopped inside a slit: no transition will confirm it
+    count = pulseCount;
+    edgeMicros = lastEdgeMicros;
+    period = slitPeriodMicros;
+  }
+
+  if (count != estimateCount) {
+    estimateCount = count;
+    subSlit = 0.0f;
+  }
+  if (period != 0 && isMoving()) {
+    subSlit = static_cast<float>(micros() - edgeMicros) / period;
+    if (subSlit > MAX_SUB_SLIT) {
+      subSlit = MAX_SUB_SLIT;
+    }
+  }
+}
+
+bool OpticalEncoder::readSensor() const {
+#ifdef DUAL_LEG
+  if (channel != 0) {
+    return FastPin<ENCODER_PIN_B>::read();
+  }
+#endif
+#ifdef ENCODER_USE_COMPARATOR
+  return ACSR & _BV(ACO); // High while AIN0 is above the threshold, like the pin
+#else
+  return FastPin<ENCODER_PIN_A>::read();
+#endif
+}
+
+uint8_t OpticalEncoder::getPin() const {
+#ifdef DUAL_LEG
+  if (channel != 0) {
+    return ENCODER_PIN_B;
+  }
+#endif
+  return ENCODER_PIN_A;
 }
 
 long OpticalEncoder::getPulseCount() const {
-  return pulseCount;
+  long count;
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    count = pulseCount;
+  }
+  return count;
 }
 
 void OpticalEncoder::setPulseCount(long count) {
-  pulseCount = count;
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    pulseCount = count;
+  }
+  resetSubSlit();
 }
 
 float OpticalEncoder::getHeightMM() const {
-  // Convert pulse count to height: pulses / (slits per mm) = mm
-  return static_cast<float>(pulseCount) / slitsPerMM;
+  return heightAtPulses(getPulseCount());
+}
+
+float OpticalEncoder::getInterpolatedHeightMM() const {
+  // The estimate belongs to the count update() last saw; a newer edge wins
+  long count = getPulseCount();
+  float height = heightAtPulses(count);
+  if (subSlit == 0.0f || count != estimateCount) {
+    return height;
+  }
+  // Blend towards the next slit so the table's local slope is respected
+  return height + (heightAtPulses(count + direction) - height) * subSlit;
+}
+
+float OpticalEncoder::heightAtPulses(long pulses) const {
+  if (!heightTable.isValid()) {
+    // Convert pulse count to height: pulses / (slits per mm) = mm
+    return static_cast<float>(pulses) / slitsPerMM;
+  }
+
+  // Uniform grid: segment index is a shift, clamped so the end segments extrapolate
+  long offset = pulses - heightTable.basePulses;
+  uint8_t shift = heightTable.shift;
+  long index = offset >> shift;
+  index = max(0L, min(index, static_cast<long>(HeightTable::SEGMENTS - 1)));
+  long frac = offset - (index << shift);
+
+  int16_t h0 = heightTable.heights[index];
+  int16_t h1 = heightTable.heights[index + 1];
+  long height = h0 + ((static_cast<long>(h1 - h0) * frac) >> shift);
+  return height * (1.0f / HeightTable::HEIGHT_SCALE);
+}
+
+void OpticalEncoder::setHeightTable(const HeightTable& table) {
+  heightTable = table;
+}
+
+const HeightTable& OpticalEncoder::getHeightTable() const {
+  return heightTable;
+}
+
+bool OpticalEncoder::buildHeightTable(HeightTable& table, long* pulses, int16_t* heights, uint8_t count) {
+  // Insertion sort by pulse count; the desk may have been calibrated top-down
+  for (uint8_t i = 1; i < count; i++) {
+    long p = pulses[i];
+    int16_t h = heights[i];
+    uint8_t j = i;
+    for (; j > 0 && pulses[j - 1] > p; j--) {
+      pulses[j] = pulses[j - 1];
+      heights[j] = heights[j - 1];
+    }
+    pulses[j] = p;
+    heights[j] = h;
+  }
+
+  for (uint8_t i = 1; i < count; i++) {
+    if (pulses[i] == pulses[i - 1]) {
+      return false; // Two heights for one position
+    }
+  }
+  if (count < 2) {
+    return false;
+  }
+
+  // Smallest segment width (power of two) that covers the calibrated span
+  long span = pulses[count - 1] - pulses[0];
+  uint8_t shift = 0;
+  while ((static_cast<long>(HeightTable::SEGMENTS) << shift) < span && shift < 24) {
+    shift++;
+  }
+
+  table.shift = shift;
+  table.basePulses = pulses[0];
+
+  // Resample the reference points onto the grid
+  uint8_t segment = 0;
+  for (uint8_t g = 0; g <= HeightTable::SEGMENTS; g++) {
+    long p = table.basePulses + (static_cast<long>(g) << shift);
+    while (segment < count - 2 && p > pulses[segment + 1]) {
+      segment++;
+    }
+    long p0 = pulses[segment];
+    long dp = pulses[segment + 1] - p0;
+    long dh = heights[segment + 1] - heights[segment];
+    long h = heights[segment] + (dh * (p - p0)) / dp;
+    table.heights[g] = static_cast<int16_t>(max(-32768L, min(h, 32767L)));
+  }
+
+  table.marker = HeightTable::VALID_MARKER;
+  return true;
 }
 
 void OpticalEncoder::setSlitsPerMM(float slitsPerMM) {
   this->slitsPerMM = slitsPerMM;
+  updateMinLevel();
+}
+
+void OpticalEncoder::setMaxSpeed(float mmPerSecond) {
+  maxSpeed = mmPerSecond;
+  updateMinLevel();
+}
+
+unsigned long OpticalEncoder::getRejectedEdges() const {
+  unsigned long rejected;
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    rejected = rejectedEdges;
+  }
+  return rejected;
+}
+
+void OpticalEncoder::updateMinLevel() {
+  // Half a slit period (one LOW or HIGH level) at the fastest plausible speed
+  float slitsPerSecond = maxSpeed * slitsPerMM;
+  unsigned long minLevel = slitsPerSecond > 0.0f ? static_cast<unsigned long>(500000.0f / slitsPerSecond) : 0;
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    minLevelMicros = minLevel; // Read by the ISR
+  }
 }
 
 float OpticalEncoder::getSlitsPerMM() const {
   return slitsPerMM;
 }
 
+void OpticalEncoder::setDirection(int8_t direction) {
+  int8_t newDirection = (direction < 0) ? -1 : 1;
+  if (newDirection != this->direction) {
+    // The estimate was towards the other neighbour
+    resetSubSlit();
+  }
+  this->direction = newDirection;
+}
+
+int8_t OpticalEncoder::getDirection() const {
+  return direction;
+}
+
 void OpticalEncoder::resetPosition() {
-  pulseCount = 0;
-  lastPulseTime = millis();
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    pulseCount = 0;
+    lastPulseTime = millis();
+  }
+  resetSubSlit();
+}
+
+void OpticalEncoder::resetSubSlit() {
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    slitPeriodMicros = 0;
+    estimateCount = pulseCount;
+  }
+  subSlit = 0.0f;
 }
 
 unsigned long OpticalEncoder::getLastPulseTime() const {
-  return lastPulseTime;
+  unsigned long time;
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    time = lastPulseTime;
+  }
+  return time;
 }
 
 bool OpticalEncoder::isMoving() const {
-  return (millis() - lastPulseTime) < MOVEMENT_TIMEOUT_MS;
+  return (millis() - getLastPulseTime()) < MOVEMENT_TIMEOUT_MS;
 }
\ No newline at end of file
@@ -3,11 +3,52 @@
 
 #include <Arduino.h>
 
+#include "FastPin.h"
+#include "Pins.h"
+
+// Piecewise-linear pulse -> height map from multi-point calibration.
+//
+// The recorded reference points are resampled onto a uniform pulse grid of
+// SEGMENTS segments, each (1 << shift) pulses wide, so a lookup is a shift, a
+// clamp and one interpolation - no search. Heights are fixed point in
+// 1/HEIGHT_SCALE mm. Outside the grid the end segments are extrapolated.
+struct HeightTable {
+  static const uint8_t SEGMENTS = 16;
+  static const uint8_t HEIGHT_SCALE = 16;
+  static const uint8_t VALID_MARKER = 0x5A;
+
+  uint8_t marker;
+  uint8_t shift;
+  long basePulses;
+  int16_t heights[SEGMENTS + 1];
+
+  bool isValid() const {
+    return marker == VALID_MARKER;
+  }
+};
+
+// Single-channel slit sensor, counted in a pin-change interrupt.
+//
+// Channel 0 is the desk's encoder on ENCODER_PIN_A (PCINT2), channel 1 the
+// second leg's on ENCODER_PIN_B (PCINT0, DUAL_LEG builds only). The ISR counts
+// and timestamps edges; update() runs in the loop and only refreshes the
+// sub-slit estimate.
+//
+// Glitch filter: every transition is timestamped, and a level only counts once
+// it has lasted minLevelMicros, half a slit period at MAX_SPEED_MM_PER_S. A
+// shorter LOW or HIGH (chatter near the threshold, flicker from fluorescent
+// light) cannot be real travel; it is dropped and counted in getRejectedEdges().
+// A slit is counted when its LOW level is confirmed: at the next transition,
+// or by update() if the desk stops in the slit. With ENCODER_USE_COMPARATOR channel 0 is read from the
+// analog comparator (ACO) against a threshold on AIN1 and interrupts on ACO
+// toggles instead of pin changes.
 class OpticalEncoder {
 public:
-  OpticalEncoder(uint8_t sensorPin, float slitsPerMM = 10.0f);
+  OpticalEncoder(float slitsPerMM = 10.0f, uint8_t channel = 0);
   void init();
   void update();
+  static void onPinChange(uint8_t channel); // Called from the ISRs
+  uint8_t getPin() const;
   long getPulseCount() const;
   void setPulseCount(long count);
   float getHeightMM() const;
@@ -15,21 +56,65 @@ public:
   // Configuration methods
   void setSlitsPerMM(float slitsPerMM);
   float getSlitsPerMM() const;
+  void setMaxSpeed(float mmPerSecond); // Fastest plausible travel; sets the glitch filter
+  unsigned long getRejectedEdges() const;
+
+  // Single-channel encoder: the controller tells it which way the desk is driven.
+  // The direction is kept after the motor stops so coasting is counted correctly.
+  void setDirection(int8_t direction);
+  int8_t getDirection() const;
   
+  // Height between slits, estimated from the last edge time and the previous slit
+  // period. Never passes the next expected edge; held while the desk is stopped.
+  float getInterpolatedHeightMM() const;
+
+  // Multi-point calibration; without a valid table height is pulses / slitsPerMM
+  void setHeightTable(const HeightTable& table);
+  const HeightTable& getHeightTable() const;
+  // Sorts the points in place. Heights are in 1/HEIGHT_SCALE mm.
+  static bool buildHeightTable(HeightTable& table, long* pulses, int16_t* heights, uint8_t count);
+
   // Calibration and diagnostics
   void resetPosition();
   unsigned long getLastPulseTime() const;
   bool isMoving() const; // Detects if pulses received recently
 
 private:
-  uint8_t sensorPin;
+  void handlePinChange();
+  void confirmLevel(unsigned long now); // Interrupts off
+  bool readSensor() const;
+  void updateMinLevel();
+
+  uint8_t channel;
   float slitsPerMM; // Number of encoder slits per mm of desk movement
-  long pulseCount;
-  int lastSensorState;
-  unsigned long lastPulseTime;
-  
+  float maxSpeed;   // mm/s
+  unsigned long minLevelMicros; // Shorter levels are glitches
+  HeightTable heightTable;
+
+  // Written by the ISR; read multi-byte values atomically
+  volatile long pulseCount;
+  volatile int8_t direction;
+  volatile bool lastSensorState;          // Raw level
+  volatile bool filteredState;            // Last level that lasted minLevelMicros
+  volatile unsigned long levelStartMicros; // When the raw level last changed
+  volatile unsigned long lastPulseTime;
+  volatile unsigned long lastEdgeMicros; // Start of the last counted slit
+  volatile unsigned long slitPeriodMicros; // 0 until two edges in the same run were seen
+  volatile unsigned long rejectedEdges;
+
+  // Sub-slit estimate, loop side
+  long estimateCount; // Pulse count the estimate refers to
+  float subSlit;      // Fraction of a slit travelled since the last edge
+
+  static OpticalEncoder* instances[2];
+
+  float heightAtPulses(long pulses) const;
+  void resetSubSlit();
+
   // Movement detection
   static const unsigned long MOVEMENT_TIMEOUT_MS = 100; // 100ms without pulses = stopped
+  static constexpr float MAX_SPEED_MM_PER_S = 60.0f;    // Default, well above the motor's top speed
+  static constexpr float MAX_SUB_SLIT = 0.9f; // Stay short of the next edge
 };
 
 #endif // OPTICALENCODER_H
@@ -0,0 +1,33 @@
+#ifndef PINS_H
+#define PINS_H
+
+#include <Arduino.h>
+
+// Pin definitions for Arduino Nano.
+// Compile-time constants so FastPin can resolve ports, bits and timer registers.
+const uint8_t UP_BUTTON_PIN = 2;       // D2 - INT0, interrupt capable pin for button
+const uint8_t DOWN_BUTTON_PIN = 3;     // D3 - INT1, interrupt capable pin for button
+const uint8_t ENDSTOP_PIN = 4;         // D4 - End stop switch
+#ifdef ENCODER_USE_COMPARATOR
+// Build with -DENCODER_USE_COMPARATOR to threshold the phototransistor with the
+// analog comparator instead of the digital input buffer
+const uint8_t ENCODER_PIN_A = 6;         // D6 - AIN0, optical encoder sensor
+const uint8_t ENCODER_THRESHOLD_PIN = 7; // D7 - AIN1, threshold divider
+#else
+const uint8_t ENCODER_PIN_A = 5;       // D5 - Optical encoder sensor pin
+#endif
+#ifdef DUAL_LEG
+// Second lifting column (build with -DDUAL_LEG). OC2B is INT1 and OC0A/OC0B are
+// taken by the first encoder, so the second bridge gets one PWM enable line
+// plus two direction lines instead of a PWM pair.
+const uint8_t ENCODER_PIN_B = 8;       // D8 - PCINT0, second leg encoder
+const uint8_t LEG_B_PWM_PIN = 11;      // D11 - OC2A, second leg bridge enable
+const uint8_t LEG_B_FORWARD_PIN = 12;  // D12 - second leg direction
+const uint8_t LEG_B_BACKWARD_PIN = 13; // D13 - second leg direction
+#endif
+const uint8_t MOTOR_FORWARD_PIN = 9;   // D9 - OC1A
+const uint8_t MOTOR_BACKWARD_PIN = 10; // D10 - OC1B
+const uint8_t I2C_SDA_PIN = 18;        // A4 - OLED, fixed by the TWI hardware
+const uint8_t I2C_SCL_PIN = 19;        // A5 - OLED, fixed by the TWI hardware
+
+#endif // PINS_H
@@ -0,0 +1,48 @@
+#include "PowerManager.h"
+#include <avr/sleep.h>
+
+// Only used to wake from sleep; nothing to do in the handler.
+// PCINT0/PCINT2 are shared with the encoders and handled in OpticalEncoder.cpp.
+EMPTY_INTERRUPT(PCINT1_vect);
+
+PowerManager::PowerManager() : pcicrMask(0), pcmskMask{0, 0, 0} {}
+
+void PowerManager::addWakePin(uint8_t pin) {
+  volatile uint8_t* pcicr = digitalPinToPCICR(pin);
+  if (pcicr == nullptr) {
+    return;
+  }
+  uint8_t group = digitalPinToPCICRbit(pin);
+  pcicrMask |= _BV(group);
+  pcmskMask[group] |= _BV(digitalPinToPCMSKbit(pin));
+}
+
+void PowerManager::sleep() {
+  Serial.flush(); // Finish transmitting before the UART clock stops
+
+  noInterrupts();
+  // The encoders keep their own pin-change bits enabled; restore them afterwards
+  uint8_t savedPcicr = PCICR;
+  uint8_t savedPcmsk0 = PCMSK0;
+  uint8_t savedPcmsk1 = PCMSK1;
+  uint8_t savedPcmsk2 = PCMSK2;
+  PCMSK0 |= pcmskMask[0];
+  PCMSK1 |= pcmskMask[1];
+  PCMSK2 |= pcmskMask[2];
+  PCIFR = pcicrMask; // Drop stale flags
+  PCICR |= pcicrMask;
+
+  set_sleep_mode(SLEEP_MODE_PWR_DOWN);
+  sleep_enable();
+  sleep_bod_disable();
+  interrupts(); // The instruction after SEI always runs, so a pending wake cannot be lost
+  sleep_cpu();
+
+  sleep_disable();
+  noInterrupts();
+  PCICR = savedPcicr;
+  PCMSK0 = savedPcmsk0;
+  PCMSK1 = savedPcmsk1;
+  PCMSK2 = savedPcmsk2;
+  interrupts();
+}
@@ -0,0 +1,24 @@
+#ifndef POWERMANAGER_H
+#define POWERMANAGER_H
+
+#include <Arduino.h>
+
+// Puts the MCU into power-down sleep until one of the registered pins changes.
+//
+// Wake-up uses pin-change interrupts, which work without clocks in power-down
+// (INT0/INT1 edge detection does not). The edge that woke us is not queued by
+// ButtonHandler, but GestureRecognizer resyncs from the pin level on its next
+// update, so the waking press is still delivered. millis() does not advance
+// while asleep. Serial input cannot wake the MCU.
+class PowerManager {
+public:
+  PowerManager();
+  void addWakePin(uint8_t pin);
+  void sleep();
+
+private:
+  uint8_t pcicrMask;
+  uint8_t pcmskMask[3]; // PCMSK0..2
+};
+
+#endif // POWERMANAGER_H
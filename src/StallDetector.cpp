@@ -0,0 +1,56 @@
+#include "StallDetector.h"
+
+StallDetector::StallDetector()
+    : lastPulseCount(0), lastPulseTime(0), pulseIntervalMs(0), hasMoved(false), stallCount(0) {}
+
+void StallDetector::reset() {
+  lastPulseTime = millis();
+  pulseIntervalMs = 0;
+  hasMoved = false;
+}
+
+bool StallDetector::update(uint8_t commandedSpeed, long pulseCount) {
+  unsigned long now = millis();
+  long newPulses = pulseCount - lastPulseCount;
+  lastPulseCount = pulseCount;
+
+  if (commandedSpeed < MIN_DETECT_SPEED) {
+    // Not armed: stopped or ramping through the deadband. The start window
+    // begins on the first call at MIN_DETECT_SPEED.
+    reset();
+    return false;
+  }
+
+  unsigned long sincePulse = now - lastPulseTime;
+  if (newPulses != 0) {
+    pulseIntervalMs = sincePulse > 0xFFFF ? 0xFFFF : static_cast<uint16_t>(sincePulse);
+    lastPulseTime = now;
+    hasMoved = true;
+    return false;
+  }
+
+  uint16_t limit;
+  if (!hasMoved) {
+    limit = START_MS;
+  } else {
+    uint32_t expected = static_cast<uint32_t>(pulseIntervalMs) * STALL_FACTOR;
+    if (expected < MIN_STALL_MS) {
+      limit = MIN_STALL_MS;
+    } else if (expected > MAX_STALL_MS) {
+      limit = MAX_STALL_MS;
+    } else {
+      limit = expected;
+    }
+  }
+
+  if (sincePulse >= limit) {
+    stallCount++;
+    reset();
+    return true;
+  }
+  return false;
+}
+
+uint16_t StallDetector::getStallCount() const {
+  return stallCount;
+}
@@ -0,0 +1,39 @@
+#ifndef STALLDETECTOR_H
+#define STALLDETECTOR_H
+
+#include <Arduino.h>
+
+// Detects a blocked desk by comparing commanded motor speed with encoder pulses.
+//
+// Called once per control loop. Detection is armed once the motor is commanded
+// at MIN_DETECT_SPEED or more; from then on the encoder must keep producing
+// pulses at roughly the rate it has been. A gap longer than STALL_FACTOR pulse
+// intervals (clamped to MIN_STALL_MS..MAX_STALL_MS) is reported as a stall, and
+// a motor that does not start is reported START_MS after arming. Limits are
+// in milliseconds, so the reaction time does not depend on the loop period or
+// the encoder resolution.
+class StallDetector {
+public:
+  StallDetector();
+
+  // Returns true on the call a stall is detected
+  bool update(uint8_t commandedSpeed, long pulseCount);
+  void reset();
+
+  uint16_t getStallCount() const;
+
+private:
+  long lastPulseCount;
+  unsigned long lastPulseTime; // Last update with new pulses, or when detection was armed
+  uint16_t pulseIntervalMs;    // Time between the last two updates with new pulses
+  bool hasMoved;
+  uint16_t stallCount;
+
+  static const uint8_t MIN_DETECT_SPEED = 64; // Below this the desk may legitimately crawl (deadband)
+  static const uint16_t START_MS = 200;       // Motor must start moving this soon after arming
+  static const uint8_t STALL_FACTOR = 3;
+  static const uint16_t MIN_STALL_MS = 40;
+  static const uint16_t MAX_STALL_MS = 80; // Below OpticalEncoder's 100 ms movement timeout
+};
+
+#endif // STALLDETECTOR_H
@@ -0,0 +1,170 @@
+#include "TraceRecorder.h"
+#include <util/atomic.h>
+
+#ifndef NO_TRACE
+
+TraceEntry TraceRecorder::entries[TraceRecorder::SIZE];
+volatile uint8_t TraceRecorder::head = 0;
+volatile uint8_t TraceRecorder::count = 0;
+volatile bool TraceRecorder::dumping = false;
+uint8_t TraceRecorder::dumpIndex = 0;
+volatile bool TraceRecorder::live = false;
+volatile uint8_t TraceRecorder::lost = 0;
+uint16_t TraceRecorder::liveTime = 0;
+
+void TraceRecorder::record(Kind kind, int8_t data) {
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    if (dumping) {
+      return;
+    }
+    TraceEntry& entry = entries[head];
+    entry.time = static_cast<uint16_t>(millis());
+    entry.kind = kind;
+    entry.data = data;
+    head = (head + 1) & (SIZE - 1);
+    if (count < SIZE) {
+      count++;
+    } else if (live && lost < 255) {
+      lost++;
+    }
+  }
+}
+
+TraceEntry* TraceRecorder::recentEntry(Kind kind, int8_t data) {
+  if (count == 0 || dumping || live) {
+    return nullptr; // Live entries are sent one by one
+  }
+  TraceEntry& last = entries[(head - 1) & (SIZE - 1)];
+  bool sameSign = (last.data > 0) == (data > 0) && (last.data < 0) == (data < 0);
+  if (last.kind != kind || !sameSign || static_cast<uint16_t>(millis()) - last.time >= MERGE_WINDOW_MS) {
+    return nullptr;
+  }
+  return &last;
+}
+
+void TraceRecorder::recordCount(Kind kind, int8_t delta) {
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    TraceEntry* last = recentEntry(kind, delta);
+    if (last != nullptr && last->data != 127 && last->data != -127) {
+      last->data += delta;
+      return;
+    }
+  }
+  record(kind, delta);
+}
+
+void TraceRecorder::recordLatest(Kind kind, int8_t value) {
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    TraceEntry* last = recentEntry(kind, value);
+    if (last != nullptr) {
+      last->time = static_cast<uint16_t>(millis());
+      last->data = value;
+      return;
+    }
+  }
+  record(kind, value);
+}
+
+void TraceRecorder::recordEdge(uint8_t channel, int8_t direction) {
+  recordCount(channel == 0 ? ENCODER_A : ENCODER_B, direction);
+}
+
+void TraceRecorder::startDump() {
+  dumping = true;
+  dumpIndex = 0;
+}
+
+void TraceRecorder::startLive(unsigned long now) {
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    count = 0;
+    lost = 0;
+    dumping = false;
+    live = true;
+  }
+  liveTime = static_cast<uint16_t>(now);
+}
+
+void TraceRecorder::stopLive() {
+  dumping = true; // Send what is left, then END
+}
+
+bool TraceRecorder::isLive() {
+  return live;
+}
+
+bool TraceRecorder::dumpStep(HardwareSerial& out) {
+  if (live) {
+    liveStep(out);
+    return live;
+  }
+  if (!dumping) {
+    return false;
+  }
+
+  // Only write what fits in the transmit buffer, so printing never blocks
+  while (dumpIndex < count && out.availableForWrite() >= MAX_LINE) {
+    const TraceEntry& entry = entries[(head - count + dumpIndex) & (SIZE - 1)];
+    out.print(entry.time);
+    out.print(',');
+    out.print(entry.kind);
+    out.print(',');
+    out.println(static_cast<int>(entry.data));
+    dumpIndex++;
+  }
+
+  if (dumpIndex < count) {
+    return true;
+  }
+  out.println(F("END"));
+  count = 0;
+  dumping = false;
+  return false;
+}
+
+bool TraceRecorder::popOldest(TraceEntry& entry) {
+  bool popped = false;
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    if (count != 0) {
+      entry = entries[(head - count) & (SIZE - 1)];
+      count--;
+      popped = true;
+    }
+  }
+  return popped;
+}
+
+void TraceRecorder::liveStep(HardwareSerial& out) {
+  if (lost != 0 && out.availableForWrite() >= MAX_LINE) {
+    uint8_t dropped;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+      dropped = lost;
+      lost = 0;
+    }
+    out.print(F("LOST,"));
+    out.println(dropped);
+  }
+
+  if (count == 0 && !dumping && static_cast<uint16_t>(millis()) - liveTime >= KEEPALIVE_MS) {
+    record(CLOCK, 0);
+  }
+
+  // Past half full, wait on the UART rather than drop entries: two encoders at
+  // full speed send more than the 64 byte buffer takes between loops
+  TraceEntry entry;
+  while ((out.availableForWrite() >= MAX_LINE || count > SIZE / 2) && popOldest(entry)) {
+    out.print(static_cast<uint16_t>(entry.time - liveTime));
+    out.print(',');
+    out.print(entry.kind);
+    out.print(',');
+    out.println(static_cast<int>(entry.data));
+    liveTime = entry.time;
+  }
+
+  if (dumping && count == 0 && out.availableForWrite() >= MAX_LINE) {
+    out.println(F("END"));
+    dumping = false;
+    live = false;
+  }
+}
+
+#endif // NO_TRACE
@@ -0,0 +1,107 @@
+#ifndef TRACERECORDER_H
+#define TRACERECORDER_H
+
+#include <Arduino.h>
+
+// One recorded event, 4 bytes
+struct TraceEntry {
+  uint16_t time; // millis() truncated to 16 bits
+  uint8_t kind;  // TraceRecorder::Kind
+  int8_t data;
+};
+
+// Ring buffer of timestamped inputs and outputs for post-mortem analysis of
+// field sessions, and as the reference a replay of the same inputs can be
+// compared against.
+//
+// record() is safe to call from ISRs. Encoder edges and display frames are
+// counted into the previous entry of the same kind for up to MERGE_WINDOW_MS,
+// and motor commands overwrite the previous one in the same direction, so the
+// buffer covers a whole move instead of a few millimetres. The oldest entries
+// are overwritten.
+//
+// The dump is streamed a line at a time from dumpStep() so the control loop and
+// the watchdog keep running; recording pauses until it is done. Lines are
+// "time,kind,data" and scripts/trace_decode.py turns them into a timeline.
+//
+// Live mode streams every entry as it is recorded, for replaying a session on
+// the host (test/test_replay). Nothing is merged, so each encoder slit and
+// display frame keeps its own time, and lines are "dt,kind,data" with dt the
+// milliseconds since the previous line (a CLOCK entry is sent after
+// KEEPALIVE_MS without one, so dt never wraps). Entries the serial port could
+// not keep up with are reported as "LOST,n". stopLive() pauses recording,
+// sends what is left and ends the stream with "END".
+//
+// Built with NO_TRACE (see DeskConfig.h), every call is an empty inline and the
+// ring takes no RAM.
+class TraceRecorder {
+public:
+  enum Kind : uint8_t {
+    BUTTON,    // data = button id << 1 | pressed
+    ENCODER_A, // data = edges, signed by counting direction
+    ENCODER_B,
+    GLITCH,    // data = encoder channel
+    ENDSTOP,   // data = triggered
+    STATE,     // data = DeskState::State entered
+    MOTOR,     // data = commanded speed / 8, signed by direction (0 = stop)
+    FRAME,     // data = full display frames sent
+    DIGITS,    // data = digit-only display frames sent
+    COMMAND,   // data = serial command character
+    CLOCK      // data = 0, live keepalive
+  };
+
+#ifdef NO_TRACE
+  static void record(Kind, int8_t) {}
+  static void recordCount(Kind, int8_t) {}
+  static void recordLatest(Kind, int8_t) {}
+  static void recordEdge(uint8_t, int8_t) {}
+  static void startDump() {}
+  static void startLive(unsigned long) {}
+  static void stopLive() {}
+
+  static bool isLive() {
+    return false;
+  }
+
+  static bool dumpStep(HardwareSerial&) {
+    return false;
+  }
+#else
+  static void record(Kind kind, int8_t data);
+  static void recordCount(Kind kind, int8_t delta);   // Adds to a recent entry of the same kind and sign
+  static void recordLatest(Kind kind, int8_t value);  // Replaces a recent entry of the same kind and sign
+  static void recordEdge(uint8_t channel, int8_t direction);
+
+  static void startDump();
+  static void startLive(unsigned long now); // Drops older entries; dt of the first line is from now
+  static void stopLive();
+  static bool isLive();
+  static bool dumpStep(HardwareSerial& out); // False once the dump is complete
+
+private:
+  static TraceEntry* recentEntry(Kind kind, int8_t data); // Interrupts off
+  static bool popOldest(TraceEntry& entry);
+  static void liveStep(HardwareSerial& out);
+
+#ifdef DUAL_LEG
+  // Two encoders fill 32 entries during one display frame at full speed (+128 bytes)
+  static const uint8_t SIZE = 64; // Must be a power of two
+#else
+  static const uint8_t SIZE = 32; // Must be a power of two
+#endif
+  static const uint16_t MERGE_WINDOW_MS = 250;
+  static const uint8_t MAX_LINE = 16; // "65535,5,-128\r\n"
+  static const uint16_t KEEPALIVE_MS = 30000;
+
+  static TraceEntry entries[SIZE];
+  static volatile uint8_t head;
+  static volatile uint8_t count;
+  static volatile bool dumping;
+  static uint8_t dumpIndex;
+  static volatile bool live;
+  static volatile uint8_t lost; // Live entries overwritten before they were sent
+  static uint16_t liveTime;     // Time of the last live line
+#endif
+};
+
+#endif // TRACERECORDER_H
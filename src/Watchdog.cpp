@@ -0,0 +1,76 @@
+#include "Watchdog.h"
+#include <avr/wdt.h>
+
+#include "FastPin.h"
+#include "Pins.h"
+
+// Loop period is ~10 ms plus a full display refresh (~30 ms). An EEPROM byte
+// takes ~3.4 ms, so a tick may write about 50 bytes: callers that save more
+// feed between the writes (the height table alone is 40 bytes, ~136 ms).
+#define WATCHDOG_TIMEOUT WDTO_250MS
+
+// Survive the watchdog reset; .bss would be cleared after .init3
+static uint8_t resetFlags __attribute__((section(".noinit")));
+static uint8_t lastContext __attribute__((section(".noinit")));
+
+static volatile uint8_t context = 0;
+
+// Runs before .data/.bss are set up. After a watchdog reset the watchdog stays
+// enabled with the shortest timeout, so it has to be turned off right away.
+// Optiboot clears MCUSR itself and hands the value over in r2.
+void captureResetCause() __attribute__((naked, used, section(".init3")));
+
+void captureResetCause() {
+  uint8_t bootloaderFlags;
+  __asm__ __volatile__("mov %0, r2" : "=r"(bootloaderFlags));
+
+  resetFlags = MCUSR != 0 ? MCUSR : bootloaderFlags;
+  MCUSR = 0;
+  wdt_disable();
+
+  if (!(resetFlags & _BV(WDRF))) {
+    lastContext = 0;
+  }
+}
+
+ISR(WDT_vect) {
+  // Deadline missed: stop the motor without trusting any driver state
+  TCCR1A = 0;
+  FastPin<MOTOR_FORWARD_PIN>::write(false);
+  FastPin<MOTOR_BACKWARD_PIN>::write(false);
+#ifdef DUAL_LEG
+  TCCR2A = 0;
+  FastPin<LEG_B_PWM_PIN>::write(false);
+#endif
+
+  lastContext = context;
+
+  // WDIE is cleared by hardware, so the next timeout resets the MCU
+  for (;;) {
+  }
+}
+
+void Watchdog::arm() {
+  wdt_enable(WATCHDOG_TIMEOUT);
+  WDTCSR |= _BV(WDIE); // Interrupt first, then reset
+}
+
+void Watchdog::disarm() {
+  wdt_disable();
+}
+
+void Watchdog::feed() {
+  wdt_reset();
+}
+
+void Watchdog::setContext(uint8_t newContext) {
+  context = newContext;
+}
+
+uint8_t Watchdog::getResetFlags() {
+  return resetFlags;
+}
+
+uint8_t Watchdog::getLastContext() {
+  return lastContext;
+}
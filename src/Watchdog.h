@@ -0,0 +1,31 @@
+#ifndef WATCHDOG_H
+#define WATCHDOG_H
+
+#include <Arduino.h>
+
+// Reset history, persisted by DeskState
+struct ResetLog {
+  uint8_t lastFlags;        // MCUSR bits of the most recent reset (PORF, EXTRF, BORF, WDRF)
+  uint8_t lastState; // Controller state (DeskState::State) when the watchdog last fired
+  uint16_t watchdogResets;
+};
+
+// Control-loop deadline monitor on the AVR watchdog.
+//
+// feed() is called once at the end of every loop. If a cycle overruns TIMEOUT
+// (blocked in Wire, EEPROM, a delay...), the watchdog interrupt cuts the motor
+// outputs directly, records the context the owner last set and waits for the
+// reset that follows one timeout later. The reset cause is captured before the
+// C runtime starts.
+class Watchdog {
+public:
+  static void arm();
+  static void disarm(); // Required before power-down sleep
+  static void feed();
+  static void setContext(uint8_t context); // Saved if the watchdog fires, e.g. the current state
+
+  static uint8_t getResetFlags();  // MCUSR as it was at boot
+  static uint8_t getLastContext(); // Valid when getResetFlags() has WDRF
+};
+
+#endif // WATCHDOG_H
@@ -0,0 +1,144 @@
+#ifndef LEGPLANT_H
+#define LEGPLANT_H
+
+#include <math.h>
+#include <stdint.h>
+
+#include "LegSyncLogic.h"
+
+// Simulated two-leg desk, stepped once per control loop in virtual time.
+//
+// Each leg is a motor with a deadband and a first-order speed response, read
+// through a 10 slit/mm encoder. step() feeds the encoder skew to LegSyncLogic,
+// the decision LegSync::update() makes on the desk, and applies its output the
+// way LegSync does: leg A at duty minus trimA, leg B at dutyB, both stopped on
+// a fault.
+class LegPlant {
+public:
+  struct Leg {
+    float positionMM;
+    float speedMMPerS;
+    float strength; // 1.0 = nominal motor, 0.88 = 12% weaker, 0 = blocked
+
+    long counts() const {
+      return static_cast<long>(floorf(positionMM * SLITS_PER_MM));
+    }
+
+    void step(uint16_t duty, int8_t direction) {
+      float target = 0.0f;
+      if (duty > DEADBAND_DUTY) {
+        target = direction * TOP_SPEED_MM_PER_S * strength * (duty - DEADBAND_DUTY) / (MAX_DUTY - DEADBAND_DUTY);
+      }
+      speedMMPerS += (target - speedMMPerS) * LOOP_MS / RESPONSE_MS;
+      positionMM += speedMMPerS * LOOP_MS / 1000.0f;
+    }
+  };
+
+  // Leg B starts skewMM below leg A; trimEnabled false drives both legs at the same duty
+  LegPlant(float strengthA, float strengthB, float startMM, float skewMM = 0.0f, bool trimEnabled = true)
+      : sync(), trimEnabled(trimEnabled), countDirection(1), nowMs(0), maxSkewMM(0.0f) {
+    a.positionMM = startMM;
+    a.speedMMPerS = 0.0f;
+    a.strength = strengthA;
+    b.positionMM = startMM - skewMM;
+    b.speedMMPerS = 0.0f;
+    b.strength = strengthB;
+  }
+
+  // One control loop at the given duty and direction (0 = stopped)
+  LegSyncLogic::Status step(uint16_t duty, int8_t direction) {
+    nowMs += LOOP_MS;
+    if (!trimEnabled) {
+      a.step(duty, direction);
+      b.step(duty, direction);
+      track();
+      return LegSyncLogic::IN_SYNC;
+    }
+
+    // Like the encoders, the counting direction is kept after the motor stops
+    if (direction != 0) {
+      countDirection = direction;
+    }
+    float skew = (a.counts() - b.counts()) / SLITS_PER_MM;
+    LegSyncLogic::Output out = sync.update(skew, countDirection, direction, duty, nowMs);
+    if (out.stop) {
+      direction = 0;
+    }
+    a.step(duty > out.trimA ? duty - out.trimA : 0, direction);
+    b.step(out.dutyB, direction);
+    track();
+    return out.status;
+  }
+
+  // Drives until leg A has travelled strokeMM; false on a fault or after timeoutMs
+  bool stroke(float strokeMM, uint16_t duty, int8_t direction, unsigned long timeoutMs = 60000) {
+    float start = a.positionMM;
+    unsigned long end = nowMs + timeoutMs;
+    while (fabsf(a.positionMM - start) < strokeMM && nowMs < end) {
+      if (step(duty, direction) == LegSyncLogic::FAULT) {
+        return false;
+      }
+    }
+    return nowMs < end;
+  }
+
+  // Steps until the status is no longer `status`, at most timeoutMs; returns the new status
+  LegSyncLogic::Status runWhile(LegSyncLogic::Status status, uint16_t duty, int8_t direction,
+                                unsigned long timeoutMs = 10000) {
+    unsigned long end = nowMs + timeoutMs;
+    LegSyncLogic::Status now = status;
+    while (now == status && nowMs < end) {
+      now = step(duty, direction);
+    }
+    return now;
+  }
+
+  void align() {
+    sync.align();
+  }
+
+  const Leg& legA() const {
+    return a;
+  }
+
+  const Leg& legB() const {
+    return b;
+  }
+
+  float getSkewMM() const {
+    return a.positionMM - b.positionMM;
+  }
+
+  float getMaxSkewMM() const {
+    return maxSkewMM;
+  }
+
+  unsigned long getTimeMs() const {
+    return nowMs;
+  }
+
+  static constexpr float SLITS_PER_MM = 10.0f;
+  static constexpr float TOP_SPEED_MM_PER_S = 40.0f;
+  static const unsigned long LOOP_MS = 12;        // delay(10) plus loop work
+  static constexpr float RESPONSE_MS = 50.0f;     // Motor and desk speed time constant
+  static const uint16_t MAX_DUTY = 400;           // MotorControl::MAX_DUTY
+  static const uint16_t DEADBAND_DUTY = 60;
+
+private:
+  void track() {
+    float trueSkew = fabsf(getSkewMM());
+    if (trueSkew > maxSkewMM) {
+      maxSkewMM = trueSkew;
+    }
+  }
+
+  LegSyncLogic sync;
+  bool trimEnabled;
+  int8_t countDirection;
+  unsigned long nowMs;
+  float maxSkewMM; // Largest true (not encoder) skew seen
+  Leg a;
+  Leg b;
+};
+
+#endif // LEGPLANT_H
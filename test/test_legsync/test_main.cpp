@@ -0,0 +1,137 @@
+#include <unity.h>
+
+#include "LegPlant.h"
+#include "LegSyncLogic.h"
+#include "LegTrim.h"
+
+void setUp() {}
+void tearDown() {}
+
+void test_no_trim_inside_deadband() {
+  TEST_ASSERT_EQUAL_UINT16(0, LegTrim::compute(0.0f));
+  TEST_ASSERT_EQUAL_UINT16(0, LegTrim::compute(LegTrim::DEADBAND_MM));
+  TEST_ASSERT_EQUAL_UINT16(0, LegTrim::compute(-5.0f)); // Lagging leg is never trimmed
+}
+
+void test_trim_is_proportional_and_saturates() {
+  TEST_ASSERT_EQUAL_UINT16(100, LegTrim::compute(1.5f));
+  TEST_ASSERT_EQUAL_UINT16(250, LegTrim::compute(3.0f));
+  TEST_ASSERT_EQUAL_UINT16(LegTrim::MAX_TRIM, LegTrim::compute(50.0f));
+}
+
+void test_plant_drifts_without_trim() {
+  // The weaker leg alone falls past the fault limit over a full stroke
+  LegPlant plant(1.0f, 0.88f, 650.0f, 0.0f, false);
+  TEST_ASSERT_TRUE(plant.stroke(600.0f, LegPlant::MAX_DUTY, 1));
+  TEST_ASSERT_TRUE(plant.getMaxSkewMM() > LegSyncLogic::FAULT_SKEW_MM);
+}
+
+void test_weaker_leg_b_full_stroke_up() {
+  LegPlant plant(1.0f, 0.88f, 650.0f);
+  TEST_ASSERT_TRUE(plant.stroke(600.0f, LegPlant::MAX_DUTY, 1));
+  TEST_ASSERT_FLOAT_WITHIN(1.0f, 0.0f, plant.getMaxSkewMM());
+}
+
+void test_weaker_leg_b_full_stroke_down() {
+  LegPlant plant(1.0f, 0.88f, 1250.0f);
+  TEST_ASSERT_TRUE(plant.stroke(600.0f, LegPlant::MAX_DUTY, -1));
+  TEST_ASSERT_FLOAT_WITHIN(1.0f, 0.0f, plant.getMaxSkewMM());
+}
+
+void test_weaker_leg_a_full_stroke_up() {
+  LegPlant plant(0.88f, 1.0f, 650.0f);
+  TEST_ASSERT_TRUE(plant.stroke(600.0f, LegPlant::MAX_DUTY, 1));
+  TEST_ASSERT_FLOAT_WITHIN(1.0f, 0.0f, plant.getMaxSkewMM());
+}
+
+void test_weaker_leg_at_part_duty() {
+  LegPlant plant(1.0f, 0.88f, 650.0f);
+  TEST_ASSERT_TRUE(plant.stroke(300.0f, 200, 1));
+  TEST_ASSERT_FLOAT_WITHIN(1.0f, 0.0f, plant.getMaxSkewMM());
+}
+
+void test_fault_is_reported_once_and_stops_both_legs() {
+  LegSyncLogic sync;
+  LegSyncLogic::Output out = sync.update(10.5f, 1, 1, 300, 0);
+  TEST_ASSERT_EQUAL(LegSyncLogic::FAULT, out.status);
+  TEST_ASSERT_TRUE(out.stop);
+
+  // Latched: the desk stays out of sync but the fault is not repeated
+  out = sync.update(10.5f, 1, 0, 0, 12);
+  TEST_ASSERT_EQUAL(LegSyncLogic::LEVELLING, out.status);
+  TEST_ASSERT_FALSE(out.stop);
+}
+
+void test_levelling_holds_the_leader_going_up() {
+  // Leg A is ahead going up: it is held while leg B catches up
+  LegPlant plant(1.0f, 1.0f, 800.0f, 10.5f);
+  TEST_ASSERT_EQUAL(LegSyncLogic::FAULT, plant.step(0, 0));
+  float heldA = plant.legA().positionMM;
+
+  TEST_ASSERT_EQUAL(LegSyncLogic::IN_SYNC, plant.runWhile(LegSyncLogic::LEVELLING, 200, 1));
+  TEST_ASSERT_FLOAT_WITHIN(0.1f, heldA, plant.legA().positionMM);
+  TEST_ASSERT_FLOAT_WITHIN(1.0f, 0.0f, plant.getSkewMM());
+}
+
+void test_levelling_holds_the_leader_going_down() {
+  // Leg B is ahead going down: it is held while leg A comes down to it
+  LegPlant plant(1.0f, 1.0f, 800.0f, 10.5f);
+  TEST_ASSERT_EQUAL(LegSyncLogic::FAULT, plant.step(0, 0));
+  float heldB = plant.legB().positionMM;
+
+  TEST_ASSERT_EQUAL(LegSyncLogic::IN_SYNC, plant.runWhile(LegSyncLogic::LEVELLING, 200, -1));
+  TEST_ASSERT_FLOAT_WITHIN(0.1f, heldB, plant.legB().positionMM);
+  TEST_ASSERT_FLOAT_WITHIN(1.0f, 0.0f, plant.getSkewMM());
+}
+
+void test_levelling_times_out_without_progress() {
+  // Leg B is blocked, so driving up never closes the gap
+  LegPlant plant(1.0f, 0.0f, 800.0f, 10.5f);
+  TEST_ASSERT_EQUAL(LegSyncLogic::FAULT, plant.step(0, 0));
+  unsigned long start = plant.getTimeMs();
+
+  TEST_ASSERT_EQUAL(LegSyncLogic::FAULT, plant.runWhile(LegSyncLogic::LEVELLING, 200, 1));
+  unsigned long levelling = plant.getTimeMs() - start;
+  TEST_ASSERT_TRUE(levelling > LegSyncLogic::LEVEL_TIMEOUT_MS);
+  TEST_ASSERT_TRUE(levelling < LegSyncLogic::LEVEL_TIMEOUT_MS + 2 * LegPlant::LOOP_MS);
+}
+
+void test_levelled_desk_syncs_normally_again() {
+  LegPlant plant(1.0f, 0.88f, 700.0f, 10.5f);
+  plant.step(0, 0);
+  TEST_ASSERT_EQUAL(LegSyncLogic::IN_SYNC, plant.runWhile(LegSyncLogic::LEVELLING, 200, 1));
+
+  // Back to proportional trim: a full stroke down stays level and never faults
+  plant.runWhile(LegSyncLogic::IN_SYNC, 0, 0, 500);
+  TEST_ASSERT_TRUE(plant.stroke(400.0f, LegPlant::MAX_DUTY, -1));
+  TEST_ASSERT_FLOAT_WITHIN(1.0f, 0.0f, plant.getSkewMM());
+}
+
+void test_align_clears_the_latch() {
+  LegSyncLogic sync;
+  sync.update(12.0f, 1, 1, 300, 0);
+  sync.align(); // Levelled by hand and counts taken as equal
+
+  LegSyncLogic::Output out = sync.update(0.0f, 1, 1, 300, 12);
+  TEST_ASSERT_EQUAL(LegSyncLogic::IN_SYNC, out.status);
+  TEST_ASSERT_EQUAL_UINT16(0, out.trimA);
+  TEST_ASSERT_EQUAL_UINT16(300, out.dutyB);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_no_trim_inside_deadband);
+  RUN_TEST(test_trim_is_proportional_and_saturates);
+  RUN_TEST(test_plant_drifts_without_trim);
+  RUN_TEST(test_weaker_leg_b_full_stroke_up);
+  RUN_TEST(test_weaker_leg_b_full_stroke_down);
+  RUN_TEST(test_weaker_leg_a_full_stroke_up);
+  RUN_TEST(test_weaker_leg_at_part_duty);
+  RUN_TEST(test_fault_is_reported_once_and_stops_both_legs);
+  RUN_TEST(test_levelling_holds_the_leader_going_up);
+  RUN_TEST(test_levelling_holds_the_leader_going_down);
+  RUN_TEST(test_levelling_times_out_without_progress);
+  RUN_TEST(test_levelled_desk_syncs_normally_again);
+  RUN_TEST(test_align_clears_the_latch);
+  return UNITY_END();
+}
@@ -0,0 +1,83 @@
+#ifndef DESKPLANT_H
+#define DESKPLANT_H
+
+#include <math.h>
+#include <stdint.h>
+
+#include "FakeHardware.h"
+#include "Replay.h"
+
+// Simulated desk on FakeHardware: the motor runs on the duty in OCR1A (up) or
+// OCR1B (down) with a deadband and a first-order speed response, and the
+// column's slits pass the encoder (LOW on the first half of each slit). Under
+// DUAL_LEG both legs move together. At rest it schedules nothing, so the
+// firmware can sleep; it picks the motion up again at the next pin change.
+class DeskPlant : public InputSource {
+public:
+  DeskPlant(float startMM, float slitsPerMM)
+      : positionMM(startMM), speedMMPerS(0.0f), slitsPerMM(slitsPerMM), lastMicros(0), encoderHigh(levelAt(startMM)) {
+    InputSchedule::driveEncoder(0, encoderHigh);
+    InputSchedule::driveEncoder(1, encoderHigh);
+  }
+
+  uint64_t nextEventMicros() override {
+    uint64_t now = FakeHardware::nowMicros();
+    if (OCR1A == 0 && OCR1B == 0 && speedMMPerS == 0.0f) {
+      lastMicros = now;
+      return FakeHardware::NO_EVENT;
+    }
+    return (lastMicros > now ? lastMicros : now) + STEP_US;
+  }
+
+  void fire(uint64_t nowMicros) override {
+    while (lastMicros + STEP_US <= nowMicros) {
+      lastMicros += STEP_US;
+      step();
+    }
+  }
+
+  float getPositionMM() const {
+    return positionMM;
+  }
+
+  static const uint16_t MAX_DUTY = 400;
+  static const uint16_t DEADBAND_DUTY = 60;
+  static constexpr float TOP_SPEED_MM_PER_S = 40.0f;
+  static constexpr float RESPONSE_MS = 80.0f;
+  static const uint64_t STEP_US = 250;
+
+private:
+  void step() {
+    uint16_t duty = OCR1A != 0 ? OCR1A : OCR1B;
+    float direction = OCR1A != 0 ? 1.0f : -1.0f;
+    float target = 0.0f;
+    if (duty > DEADBAND_DUTY) {
+      target = direction * TOP_SPEED_MM_PER_S * (duty - DEADBAND_DUTY) / (MAX_DUTY - DEADBAND_DUTY);
+    }
+    speedMMPerS += (target - speedMMPerS) * (STEP_US / 1000.0f) / RESPONSE_MS;
+    if (target == 0.0f && fabsf(speedMMPerS) < 0.05f) {
+      speedMMPerS = 0.0f;
+    }
+    positionMM += speedMMPerS * STEP_US / 1e6f;
+
+    bool high = levelAt(positionMM);
+    if (high != encoderHigh) {
+      encoderHigh = high;
+      InputSchedule::driveEncoder(0, high);
+      InputSchedule::driveEncoder(1, high);
+    }
+  }
+
+  bool levelAt(float mm) const {
+    float slits = mm * slitsPerMM;
+    return slits - floorf(slits) >= 0.5f;
+  }
+
+  float positionMM;
+  float speedMMPerS;
+  float slitsPerMM;
+  uint64_t lastMicros;
+  bool encoderHigh;
+};
+
+#endif // DESKPLANT_H
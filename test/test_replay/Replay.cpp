@@ -0,0 +1,363 @@
+#include "Replay.h"
+
+#include <algorithm>
+#include <stdlib.h>
+
+#include "Pins.h"
+#include "TraceRecorder.h"
+
+static const uint64_t MIN_SLIT_US = 2000; // Closer slits (over 50 mm/s at 10 slits/mm) are spread out
+static const uint64_t MAX_LOW_US = 5000;  // LOW level of the first slit of a run
+static const uint64_t BLIP_US = 10;       // Glitch width, far below the filter's minimum level
+static const size_t RESYNC_WINDOW = 8;    // Entries looked ahead to line up after a difference
+
+static const char* const KIND_NAMES[] = {"BUTTON", "ENCODER_A", "ENCODER_B", "GLITCH", "ENDSTOP", "STATE",
+                                         "MOTOR",  "FRAME",     "DIGITS",    "COMMAND", "CLOCK"};
+
+// --- Parsing ------------------------------------------------------------------
+
+// Exactly count comma-separated integers
+static bool parseInts(const std::string& text, long* values, size_t count) {
+  const char* p = text.c_str();
+  for (size_t i = 0; i < count; i++) {
+    char* end;
+    values[i] = strtol(p, &end, 10);
+    if (end == p || *end != (i + 1 < count ? ',' : '\0')) {
+      return false;
+    }
+    p = end + 1;
+  }
+  return true;
+}
+
+static bool startsWith(const std::string& line, const char* prefix) {
+  return line.compare(0, strlen(prefix), prefix) == 0;
+}
+
+static void parseEeprom(const std::string& fields, std::vector<uint8_t>& image) {
+  size_t comma = fields.find(',');
+  if (comma == std::string::npos) {
+    return;
+  }
+  size_t address = strtoul(fields.c_str(), nullptr, 10);
+  for (size_t i = comma + 1; i + 1 < fields.size(); i += 2) {
+    if (image.size() <= address) {
+      image.resize(address + 1, 0xFF);
+    }
+    image[address++] = static_cast<uint8_t>(strtoul(fields.substr(i, 2).c_str(), nullptr, 16));
+  }
+}
+
+bool parseLiveCapture(const std::string& log, LiveCapture& capture) {
+  capture = LiveCapture();
+  bool started = false;
+  uint32_t time = 0;
+  size_t pos = 0;
+  while (pos < log.size() && !capture.complete) {
+    size_t end = log.find('\n', pos);
+    if (end == std::string::npos) {
+      end = log.size();
+    }
+    std::string line = log.substr(pos, end - pos);
+    pos = end + 1;
+    if (!line.empty() && line.back() == '\r') {
+      line.pop_back();
+    }
+
+    long values[3];
+    if (!started) {
+      if (startsWith(line, "LIVE,") && parseInts(line.substr(5), values, 2)) {
+        started = true;
+        capture.startMs = static_cast<uint32_t>(values[0]);
+        capture.startPulses = values[1];
+        time = capture.startMs;
+      }
+    } else if (line == "END") {
+      capture.complete = true;
+    } else if (startsWith(line, "EEPROM,")) {
+      parseEeprom(line.substr(7), capture.eeprom);
+    } else if (startsWith(line, "LOST,") && parseInts(line.substr(5), values, 1)) {
+      capture.lost += values[0];
+    } else if (parseInts(line, values, 3)) {
+      time += values[0];
+      TraceLine entry = {time, static_cast<uint8_t>(values[1]), static_cast<int8_t>(values[2])};
+      capture.entries.push_back(entry);
+    }
+  }
+  return started;
+}
+
+// --- Inputs -------------------------------------------------------------------
+
+InputSchedule::InputSchedule() : next(0), sorted(true) {}
+
+void InputSchedule::pin(uint64_t micros, uint8_t pin, bool high) {
+  add(Event{micros, Event::PIN, pin, high});
+}
+
+void InputSchedule::encoder(uint64_t micros, uint8_t channel, bool high) {
+  add(Event{micros, Event::ENCODER, channel, high});
+}
+
+void InputSchedule::command(uint64_t micros, char c) {
+  add(Event{micros, Event::COMMAND, static_cast<uint8_t>(c), false});
+}
+
+void InputSchedule::add(const Event& event) {
+  if (!events.empty() && event.micros < events.back().micros) {
+    sorted = false;
+  }
+  events.push_back(event);
+}
+
+void InputSchedule::driveEncoder(uint8_t channel, bool high) {
+#ifdef DUAL_LEG
+  if (channel != 0) {
+    FakeHardware::setPin(ENCODER_PIN_B, high);
+    return;
+  }
+#endif
+  if (channel != 0) {
+    return;
+  }
+  FakeHardware::setPin(ENCODER_PIN_A, high); // The pin change also wakes the CPU
+#ifdef ENCODER_USE_COMPARATOR
+  FakeHardware::setComparator(high);
+#endif
+}
+
+uint64_t InputSchedule::nextEventMicros() {
+  if (!sorted) {
+    std::stable_sort(events.begin() + next, events.end(),
+                     [](const Event& a, const Event& b) { return a.micros < b.micros; });
+    sorted = true;
+  }
+  return next < events.size() ? events[next].micros : FakeHardware::NO_EVENT;
+}
+
+void InputSchedule::fire(uint64_t nowMicros) {
+  while (next < events.size() && events[next].micros <= nowMicros) {
+    const Event& event = events[next++];
+    switch (event.type) {
+    case Event::PIN:
+      FakeHardware::setPin(event.target, event.high);
+      break;
+    case Event::ENCODER:
+      driveEncoder(event.target, event.high);
+      break;
+    case Event::COMMAND:
+      FakeHardware::serialInput(static_cast<char>(event.target));
+      break;
+    }
+  }
+}
+
+void scheduleCapture(const LiveCapture& capture, InputSchedule& inputs) {
+  struct LowLevel {
+    uint64_t start;
+    uint64_t end;
+  };
+  std::vector<LowLevel> slits[2];
+  std::vector<TraceLine> glitches;
+  uint64_t lastSlit[2] = {0, 0};
+
+  inputs.command(capture.startMs * 1000ULL, 'T');
+  for (const TraceLine& entry : capture.entries) {
+    uint64_t micros = entry.timeMs * 1000ULL + 500; // Middle of the millisecond it was recorded in
+    switch (entry.kind) {
+    case TraceRecorder::BUTTON:
+      inputs.pin(micros, (entry.data >> 1) == 0 ? UP_BUTTON_PIN : DOWN_BUTTON_PIN, !(entry.data & 1));
+      break;
+
+    case TraceRecorder::ENDSTOP:
+      inputs.pin(micros, ENDSTOP_PIN, entry.data == 0); // Active low
+      break;
+
+    case TraceRecorder::ENCODER_A:
+    case TraceRecorder::ENCODER_B: {
+      // The entry is where the slit was counted: at the end of its LOW level
+      uint8_t channel = entry.kind == TraceRecorder::ENCODER_A ? 0 : 1;
+      int count = abs(entry.data);
+      for (int i = 0; i < count; i++) {
+        uint64_t end = micros - (count - 1 - i) * MIN_SLIT_US;
+        if (end < lastSlit[channel] + MIN_SLIT_US) {
+          end = lastSlit[channel] + MIN_SLIT_US;
+        }
+        uint64_t low = std::min((end - lastSlit[channel]) / 2, MAX_LOW_US);
+        inputs.encoder(end - low, channel, false);
+        inputs.encoder(end, channel, true);
+        slits[channel].push_back(LowLevel{end - low, end});
+        lastSlit[channel] = end;
+      }
+      break;
+    }
+
+    case TraceRecorder::GLITCH:
+      glitches.push_back(entry);
+      break;
+
+    case TraceRecorder::COMMAND:
+      inputs.command(entry.timeMs * 1000ULL, static_cast<char>(entry.data));
+      break;
+
+    default:
+      break; // Outputs
+    }
+  }
+
+  // A blip inside a slit's LOW level would end it early; move it just past
+  for (const TraceLine& glitch : glitches) {
+    uint8_t channel = glitch.data != 0 ? 1 : 0;
+    uint64_t start = glitch.timeMs * 1000ULL + 500 - BLIP_US;
+    for (const LowLevel& slit : slits[channel]) {
+      if (start + BLIP_US >= slit.start && start <= slit.end) {
+        start = slit.end + BLIP_US;
+      }
+    }
+    inputs.encoder(start, channel, false);
+    inputs.encoder(start + BLIP_US, channel, true);
+  }
+}
+
+// --- Replay and comparison ----------------------------------------------------
+
+void Replay::resetFirmware() {
+  ButtonEdge edge;
+  while (ButtonHandler::popEdge(edge)) {
+  }
+  if (TraceRecorder::isLive()) {
+    TraceRecorder::stopLive();
+    while (TraceRecorder::dumpStep(Serial)) {
+      FakeHardware::advance(1000);
+    }
+  }
+  FakeHardware::takeSerialOutput();
+}
+
+void Replay::runLoop(Desk& desk, uint64_t untilMicros) {
+  while (FakeHardware::nowMicros() < untilMicros) {
+    desk.update();
+    FakeHardware::advance(UPDATE_US);
+    delay(10);
+  }
+}
+
+ReplayReport Replay::run(const LiveCapture& capture) {
+  FakeHardware::reset();
+  resetFirmware();
+  size_t imageSize = std::min(capture.eeprom.size(), static_cast<size_t>(FakeHardware::EEPROM_SIZE));
+  memcpy(FakeHardware::eeprom(), capture.eeprom.data(), imageSize);
+  uint32_t bootMs = capture.startMs > BOOT_LEAD_MS ? capture.startMs - BOOT_LEAD_MS : 0;
+  FakeHardware::jumpTo(bootMs * 1000ULL);
+
+  InputSchedule inputs;
+  scheduleCapture(capture, inputs);
+  FakeHardware::addSource(&inputs);
+
+  uint32_t lastMs = capture.entries.empty() ? capture.startMs : capture.entries.back().timeMs;
+  Desk* desk = new Desk();
+  Serial.begin(115200);
+  desk->init();
+  runLoop(*desk, (lastMs + SETTLE_MS) * 1000ULL);
+  delete desk;
+
+  ReplayReport report = ReplayReport();
+  report.longestWatchdogGapMs = FakeHardware::longestWatchdogGapMicros() / 1000;
+  LiveCapture replayed;
+  if (!parseLiveCapture(FakeHardware::takeSerialOutput(), replayed)) {
+    report.differences.push_back("the replay did not start a live trace");
+    return report;
+  }
+  compare(capture, replayed, report);
+  return report;
+}
+
+static bool isOutput(const TraceLine& entry) {
+  return entry.kind == TraceRecorder::STATE || entry.kind == TraceRecorder::MOTOR ||
+         entry.kind == TraceRecorder::FRAME || entry.kind == TraceRecorder::DIGITS;
+}
+
+static long countSlits(const LiveCapture& capture) {
+  long slits = 0;
+  for (const TraceLine& entry : capture.entries) {
+    if (entry.kind == TraceRecorder::ENCODER_A) {
+      slits += abs(entry.data);
+    }
+  }
+  return slits;
+}
+
+static bool sameOutput(const TraceLine& a, const TraceLine& b) {
+  uint32_t gap = a.timeMs > b.timeMs ? a.timeMs - b.timeMs : b.timeMs - a.timeMs;
+  return a.kind == b.kind && a.data == b.data && gap <= Replay::TIME_TOLERANCE_MS;
+}
+
+static std::string describe(const TraceLine& entry) {
+  char text[48];
+  const char* kind = entry.kind < sizeof(KIND_NAMES) / sizeof(KIND_NAMES[0]) ? KIND_NAMES[entry.kind] : "?";
+  snprintf(text, sizeof(text), "%s %d at %u ms", kind, entry.data, static_cast<unsigned>(entry.timeMs));
+  return text;
+}
+
+// Entries to skip in list, from index, until one matches wanted; 0 if none within RESYNC_WINDOW
+static size_t lookAhead(const std::vector<TraceLine>& list, size_t index, const TraceLine& wanted) {
+  for (size_t skip = 1; skip <= RESYNC_WINDOW && index + skip < list.size(); skip++) {
+    if (sameOutput(list[index + skip], wanted)) {
+      return skip;
+    }
+  }
+  return 0;
+}
+
+void Replay::compare(const LiveCapture& recorded, const LiveCapture& replayed, ReplayReport& report) {
+  report.recordedSlits = countSlits(recorded);
+  report.replayedSlits = countSlits(replayed);
+  report.sameEeprom = recorded.eeprom == replayed.eeprom;
+  report.replayComplete = replayed.complete;
+  if (!report.sameEeprom) {
+    report.differences.push_back("the replay's EEPROM image differs from the recorded one");
+  }
+  if (recorded.complete && !replayed.complete) {
+    report.differences.push_back("the replay's live trace did not end");
+  }
+  if (report.recordedSlits != report.replayedSlits) {
+    report.differences.push_back("encoder A counted " + std::to_string(report.replayedSlits) + " slits, recorded " +
+                                 std::to_string(report.recordedSlits));
+  }
+
+  std::vector<TraceLine> expected;
+  std::vector<TraceLine> actual;
+  std::copy_if(recorded.entries.begin(), recorded.entries.end(), std::back_inserter(expected), isOutput);
+  std::copy_if(replayed.entries.begin(), replayed.entries.end(), std::back_inserter(actual), isOutput);
+  report.outputs = expected.size();
+
+  size_t i = 0;
+  size_t j = 0;
+  while (i < expected.size() || j < actual.size()) {
+    if (i < expected.size() && j < actual.size()) {
+      if (sameOutput(expected[i], actual[j])) {
+        report.matched++;
+        i++;
+        j++;
+        continue;
+      }
+      size_t extra = lookAhead(actual, j, expected[i]);
+      size_t missing = lookAhead(expected, i, actual[j]);
+      if (extra != 0 && (missing == 0 || extra <= missing)) {
+        for (; extra > 0; extra--) {
+          report.differences.push_back("unexpected " + describe(actual[j++]));
+        }
+      } else if (missing != 0) {
+        for (; missing > 0; missing--) {
+          report.differences.push_back("missing " + describe(expected[i++]));
+        }
+      } else {
+        report.differences.push_back("expected " + describe(expected[i++]) + ", replay sent " + describe(actual[j++]));
+      }
+    } else if (i < expected.size()) {
+      report.differences.push_back("missing " + describe(expected[i++]));
+    } else {
+      report.differences.push_back("unexpected " + describe(actual[j++]));
+    }
+  }
+}
@@ -0,0 +1,98 @@
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "DeskConfig.h"
+#include "FakeHardware.h"
+
+#ifdef NO_TRACE
+#error "The replay compares live traces: build it without NO_TRACE"
+#endif
+
+// Replays a live trace ('T', see TraceRecorder) through the firmware on
+// FakeHardware: a fresh controller boots on the EEPROM image from the stream,
+// gets the recorded inputs at their recorded times, and its own live stream
+// is compared with the recorded one, output by output.
+
+struct TraceLine {
+  uint32_t timeMs; // millis() at the entry, rebuilt from the dt column
+  uint8_t kind;    // TraceRecorder::Kind
+  int8_t data;
+};
+
+// One 'T' session as sent over serial
+struct LiveCapture {
+  bool complete; // Ended with END
+  uint32_t startMs;
+  long startPulses;
+  unsigned lost; // Entries reported as LOST
+  std::vector<uint8_t> eeprom;
+  std::vector<TraceLine> entries;
+};
+
+// The first live session in a serial log; other output in between is skipped.
+// False if there is none.
+bool parseLiveCapture(const std::string& log, LiveCapture& capture);
+
+// Pin levels and serial characters at fixed times
+class InputSchedule : public InputSource {
+public:
+  InputSchedule();
+  void pin(uint64_t micros, uint8_t pin, bool high);
+  void encoder(uint64_t micros, uint8_t channel, bool high); // Channel 0 follows ENCODER_USE_COMPARATOR
+  void command(uint64_t micros, char c);
+  static void driveEncoder(uint8_t channel, bool high);
+
+  uint64_t nextEventMicros() override;
+  void fire(uint64_t nowMicros) override;
+
+private:
+  struct Event {
+    uint64_t micros;
+    enum Type : uint8_t { PIN, ENCODER, COMMAND } type;
+    uint8_t target; // Pin, encoder channel or character
+    bool high;
+  };
+  void add(const Event& event);
+
+  std::vector<Event> events;
+  size_t next;
+  bool sorted;
+};
+
+// The recorded inputs of a capture as pin levels: buttons and the end stop as
+// recorded, each encoder slit as a LOW level ending at its entry's time (so the
+// glitch filter confirms it there), glitches as 10 us blips, and serial
+// commands as received. The 'T' that started the session is added at its start.
+void scheduleCapture(const LiveCapture& capture, InputSchedule& inputs);
+
+struct ReplayReport {
+  size_t outputs;  // Recorded STATE, MOTOR, FRAME and DIGITS entries
+  size_t matched;  // ... found in the replay, in order and within TIME_TOLERANCE_MS
+  long recordedSlits;
+  long replayedSlits;
+  bool sameEeprom; // The replay's own image at 'T' matches the recorded one
+  bool replayComplete;
+  uint32_t longestWatchdogGapMs;
+  std::vector<std::string> differences;
+};
+
+class Replay {
+public:
+  static ReplayReport run(const LiveCapture& capture);
+  static void compare(const LiveCapture& recorded, const LiveCapture& replayed, ReplayReport& report);
+
+  static void resetFirmware(); // Static firmware state left over from a previous run
+  // ElevatingDesk's loop: update(), UPDATE_US of CPU time, delay(10)
+  static void runLoop(Desk& desk, uint64_t untilMicros);
+
+  static const uint32_t TIME_TOLERANCE_MS = 40; // A few loops: inputs are replayed with 1 ms resolution
+  static const uint32_t BOOT_LEAD_MS = 3000;    // Boot this long before 'T' so the display is up
+  static const uint32_t SETTLE_MS = 2000;       // Keep running after the last entry
+  static const uint32_t UPDATE_US = 1000;       // CPU time of one update() besides I/O, roughly
+};
+
+#endif // REPLAY_H
@@ -0,0 +1,26 @@
+#ifndef FAKE_ADAFRUIT_GFX_H
+#define FAKE_ADAFRUIT_GFX_H
+
+#include <Arduino.h>
+
+// Drawing is not rendered: the replay compares frames sent, not pixels
+class Adafruit_GFX : public Print {
+public:
+  Adafruit_GFX(int16_t w, int16_t h) : width(w), height(h) {}
+
+  void setTextSize(uint8_t) {}
+  void setTextColor(uint16_t) {}
+  void setTextColor(uint16_t, uint16_t) {}
+  void setCursor(int16_t, int16_t) {}
+  void fillRect(int16_t, int16_t, int16_t, int16_t, uint16_t) {}
+  size_t write(uint8_t) override {
+    return 1;
+  }
+  using Print::write;
+
+protected:
+  int16_t width;
+  int16_t height;
+};
+
+#endif // FAKE_ADAFRUIT_GFX_H
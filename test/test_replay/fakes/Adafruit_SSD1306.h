@@ -0,0 +1,38 @@
+#ifndef FAKE_ADAFRUIT_SSD1306_H
+#define FAKE_ADAFRUIT_SSD1306_H
+
+#include <Adafruit_GFX.h>
+#include <Wire.h>
+
+#define SSD1306_BLACK 0
+#define SSD1306_WHITE 1
+#define SSD1306_SWITCHCAPVCC 0x02
+#define SSD1306_COLUMNADDR 0x21
+#define SSD1306_PAGEADDR 0x22
+#define SSD1306_DISPLAYOFF 0xAE
+#define SSD1306_DISPLAYON 0xAF
+
+// Frame buffer and command traffic of the real driver; begin() sends the
+// init sequence's worth of bytes over Wire and, like the driver, ignores the ack
+class Adafruit_SSD1306 : public Adafruit_GFX {
+public:
+  Adafruit_SSD1306(uint8_t w, uint8_t h, TwoWire* twi, int8_t rstPin = -1, uint32_t clkDuring = 400000UL,
+                   uint32_t clkAfter = 100000UL);
+  ~Adafruit_SSD1306();
+
+  bool begin(uint8_t switchvcc = SSD1306_SWITCHCAPVCC, uint8_t i2caddr = 0, bool reset = true,
+             bool periphBegin = true);
+  void clearDisplay();
+  void dim(bool dim);
+  void ssd1306_command(uint8_t c);
+  uint8_t* getBuffer();
+
+private:
+  void commands(uint8_t count);
+
+  TwoWire* wire;
+  uint8_t address;
+  uint8_t* buffer;
+};
+
+#endif // FAKE_ADAFRUIT_SSD1306_H
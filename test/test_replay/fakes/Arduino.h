@@ -0,0 +1,114 @@
+#ifndef FAKE_ARDUINO_H
+#define FAKE_ARDUINO_H
+
+// The parts of the Arduino AVR core the firmware uses, on FakeHardware's
+// virtual clock and pins (see FakeHardware.h)
+
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <type_traits>
+
+#include "avr/interrupt.h"
+#include "avr/io.h"
+#include "avr/pgmspace.h"
+
+#define HIGH 0x1
+#define LOW 0x0
+
+#define INPUT 0x0
+#define OUTPUT 0x1
+#define INPUT_PULLUP 0x2
+
+#define CHANGE 1
+#define FALLING 2
+#define RISING 3
+
+#define DEC 10
+#define HEX 16
+
+// Functions rather than the core's macros, so std headers still compile after this one
+template <class T, class U>
+inline typename std::common_type<T, U>::type min(const T& a, const U& b) {
+  return a < b ? a : b;
+}
+template <class T, class U>
+inline typename std::common_type<T, U>::type max(const T& a, const U& b) {
+  return a > b ? a : b;
+}
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+
+void pinMode(uint8_t pin, uint8_t mode);
+int digitalRead(uint8_t pin);
+void digitalWrite(uint8_t pin, uint8_t value);
+
+void attachInterrupt(uint8_t interruptNum, void (*handler)(), int mode);
+void detachInterrupt(uint8_t interruptNum);
+
+// ATmega328P pin-change groups: D0-D7 PCINT2, D8-D13 PCINT0, A0-A5 PCINT1
+#define digitalPinToPCICR(p) (((p) >= 0 && (p) <= 21) ? &PCICR : static_cast<volatile uint8_t*>(nullptr))
+#define digitalPinToPCICRbit(p) (((p) <= 7) ? 2 : (((p) <= 13) ? 0 : 1))
+#define digitalPinToPCMSK(p) (((p) <= 7) ? &PCMSK2 : (((p) <= 13) ? &PCMSK0 : &PCMSK1))
+#define digitalPinToPCMSKbit(p) (((p) <= 7) ? (p) : (((p) <= 13) ? ((p) - 8) : ((p) - 14)))
+
+class __FlashStringHelper;
+#define F(string_literal) (reinterpret_cast<const __FlashStringHelper*>(string_literal))
+
+class Print {
+public:
+  virtual ~Print() {}
+  virtual size_t write(uint8_t c) = 0;
+  virtual size_t write(const uint8_t* buffer, size_t size);
+  size_t write(const char* str);
+
+  size_t print(const __FlashStringHelper* str);
+  size_t print(const char* str);
+  size_t print(char c);
+  size_t print(unsigned char value, int base = DEC);
+  size_t print(int value, int base = DEC);
+  size_t print(unsigned int value, int base = DEC);
+  size_t print(long value, int base = DEC);
+  size_t print(unsigned long value, int base = DEC);
+  size_t print(double value, int digits = 2);
+
+  size_t println(const __FlashStringHelper* str);
+  size_t println(const char* str);
+  size_t println(char c);
+  size_t println(unsigned char value, int base = DEC);
+  size_t println(int value, int base = DEC);
+  size_t println(unsigned int value, int base = DEC);
+  size_t println(long value, int base = DEC);
+  size_t println(unsigned long value, int base = DEC);
+  size_t println(double value, int digits = 2);
+  size_t println();
+
+private:
+  size_t printNumber(unsigned long value, int base);
+};
+
+// UART with a 64-byte transmit buffer drained at the baud rate, so a full
+// buffer blocks like on the chip. Output and input are FakeHardware's.
+class HardwareSerial : public Print {
+public:
+  void begin(unsigned long baud);
+  int available();
+  int read();
+  int availableForWrite();
+  void flush();
+  size_t write(uint8_t c) override;
+  using Print::write;
+  operator bool() {
+    return true;
+  }
+};
+
+extern HardwareSerial Serial;
+
+#endif // FAKE_ARDUINO_H
@@ -0,0 +1,36 @@
+#ifndef FAKE_EEPROM_H
+#define FAKE_EEPROM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// 1 KB EEPROM in FakeHardware; a changed byte takes EEPROM_WRITE_US like the chip's
+class EEPROMClass {
+public:
+  uint8_t read(int address);
+  void write(int address, uint8_t value);
+  void update(int address, uint8_t value);
+  uint16_t length();
+
+  template <typename T>
+  T& get(int address, T& value) {
+    uint8_t* bytes = reinterpret_cast<uint8_t*>(&value);
+    for (size_t i = 0; i < sizeof(T); i++) {
+      bytes[i] = read(address + i);
+    }
+    return value;
+  }
+
+  template <typename T>
+  const T& put(int address, const T& value) {
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&value);
+    for (size_t i = 0; i < sizeof(T); i++) {
+      update(address + i, bytes[i]);
+    }
+    return value;
+  }
+};
+
+extern EEPROMClass EEPROM;
+
+#endif // FAKE_EEPROM_H
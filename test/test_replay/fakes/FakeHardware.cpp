@@ -0,0 +1,620 @@
+#include "FakeHardware.h"
+
+#include <Adafruit_SSD1306.h>
+#include <Arduino.h>
+#include <EEPROM.h>
+#include <Wire.h>
+#include <avr/sleep.h>
+
+#include "MemoryMonitor.h"
+#include "Watchdog.h"
+
+// Vectors the firmware may define; weak, so a build without one still links
+extern "C" void PCINT0_vect(void) __attribute__((weak));
+extern "C" void PCINT1_vect(void) __attribute__((weak));
+extern "C" void PCINT2_vect(void) __attribute__((weak));
+extern "C" void ANALOG_COMP_vect(void) __attribute__((weak));
+
+volatile uint8_t PINB, DDRB, PORTB;
+volatile uint8_t PINC, DDRC, PORTC;
+volatile uint8_t PIND, DDRD, PORTD;
+volatile uint8_t PCICR, PCIFR, PCMSK0, PCMSK1, PCMSK2;
+volatile uint8_t ADCSRB;
+ComparatorStatus ACSR;
+volatile uint8_t MCUSR, WDTCSR;
+volatile uint8_t TCCR1A, TCCR1B;
+volatile uint16_t ICR1, OCR1A, OCR1B, TCNT1;
+volatile uint8_t TCCR2A, TCCR2B, OCR2A, TCNT2;
+
+HardwareSerial Serial;
+EEPROMClass EEPROM;
+TwoWire Wire;
+
+static uint64_t now = 0;
+static std::vector<InputSource*> sources;
+static bool asleep = false;
+static bool woken = false;
+static bool stuckAsleep = false;
+static bool displayPresent = true;
+static uint8_t eepromBytes[FakeHardware::EEPROM_SIZE];
+static void (*interruptHandlers[2])() = {nullptr, nullptr};
+static int interruptModes[2] = {0, 0};
+static bool watchdogArmed = false;
+static uint64_t lastFeed = 0;
+static uint64_t longestFeedGap = 0;
+
+uint32_t FakeHardware::serialByteMicros = 87; // 115200 baud, 10 bits per byte
+uint64_t FakeHardware::serialIdleAt = 0;
+std::string FakeHardware::serialOut;
+std::vector<char> FakeHardware::serialIn;
+
+static volatile uint8_t* inputRegister(uint8_t pin) {
+  return pin < 8 ? &PIND : (pin < 14 ? &PINB : &PINC);
+}
+
+static volatile uint8_t* outputRegister(uint8_t pin) {
+  return pin < 8 ? &PORTD : (pin < 14 ? &PORTB : &PORTC);
+}
+
+static volatile uint8_t* directionRegister(uint8_t pin) {
+  return pin < 8 ? &DDRD : (pin < 14 ? &DDRB : &DDRC);
+}
+
+static uint8_t pinMask(uint8_t pin) {
+  return 1 << (pin < 8 ? pin : (pin < 14 ? pin - 8 : pin - 14));
+}
+
+// --- Clock, sources and sleep -------------------------------------------------
+
+void FakeHardware::reset() {
+  now = 0;
+  sources.clear();
+  asleep = false;
+  woken = false;
+  stuckAsleep = false;
+  displayPresent = true;
+  memset(eepromBytes, 0xFF, sizeof(eepromBytes));
+  interruptHandlers[0] = interruptHandlers[1] = nullptr;
+  watchdogArmed = false;
+  lastFeed = 0;
+  longestFeedGap = 0;
+  serialByteMicros = 87;
+  serialIdleAt = 0;
+  serialOut.clear();
+  serialIn.clear();
+
+  // Everything released and pulled up; registers at their reset values
+  PINB = PINC = PIND = 0xFF;
+  DDRB = DDRC = DDRD = 0;
+  PORTB = PORTC = PORTD = 0;
+  PCICR = PCIFR = PCMSK0 = PCMSK1 = PCMSK2 = 0;
+  ACSR.value = _BV(ACO); // The encoder's AIN0 follows its lit pin
+  ADCSRB = 0;
+  MCUSR = WDTCSR = 0;
+  TCCR1A = TCCR1B = 0;
+  ICR1 = OCR1A = OCR1B = TCNT1 = 0;
+  TCCR2A = TCCR2B = OCR2A = TCNT2 = 0;
+}
+
+void FakeHardware::addSource(InputSource* source) {
+  sources.push_back(source);
+}
+
+uint64_t FakeHardware::nowMicros() {
+  return now;
+}
+
+void FakeHardware::jumpTo(uint64_t micros) {
+  if (micros > now) {
+    now = micros;
+  }
+}
+
+InputSource* FakeHardware::nextSource(uint64_t limit, uint64_t& when) {
+  InputSource* next = nullptr;
+  when = limit;
+  for (InputSource* source : sources) {
+    uint64_t t = source->nextEventMicros();
+    if (t != NO_EVENT && (next == nullptr ? t <= when : t < when)) {
+      next = source;
+      when = t;
+    }
+  }
+  return next;
+}
+
+void FakeHardware::advance(uint64_t micros) {
+  uint64_t end = now + micros;
+  uint64_t when;
+  while (InputSource* source = nextSource(end, when)) {
+    if (when > now) {
+      now = when;
+    }
+    source->fire(now);
+  }
+  now = end;
+}
+
+void FakeHardware::sleep() {
+  // Power-down: the clock stops, only a pin change brings the CPU back
+  asleep = true;
+  woken = false;
+  uint64_t when;
+  while (!woken) {
+    InputSource* source = nextSource(NO_EVENT - 1, when);
+    if (source == nullptr) {
+      stuckAsleep = true;
+      break;
+    }
+    if (when > now) {
+      now = when;
+    }
+    source->fire(now);
+  }
+  asleep = false;
+}
+
+bool FakeHardware::isAsleep() {
+  return asleep;
+}
+
+bool FakeHardware::sleptForever() {
+  return stuckAsleep;
+}
+
+// --- Pins and interrupts ------------------------------------------------------
+
+void FakeHardware::setPin(uint8_t pin, bool high) {
+  volatile uint8_t* reg = inputRegister(pin);
+  uint8_t mask = pinMask(pin);
+  if (static_cast<bool>(*reg & mask) == high) {
+    return;
+  }
+  *reg = high ? (*reg | mask) : (*reg & ~mask);
+
+  if (pin == 2 || pin == 3) {
+    externalInterrupt(pin - 2, high);
+  }
+  pinChange(pin);
+}
+
+bool FakeHardware::getPin(uint8_t pin) {
+  return *inputRegister(pin) & pinMask(pin);
+}
+
+void FakeHardware::externalInterrupt(uint8_t interruptNum, bool high) {
+  // Edge detection needs the I/O clock, which power-down stops
+  void (*handler)() = interruptHandlers[interruptNum];
+  if (handler == nullptr || asleep) {
+    return;
+  }
+  int mode = interruptModes[interruptNum];
+  if (mode == CHANGE || (mode == RISING && high) || (mode == FALLING && !high)) {
+    handler();
+  }
+}
+
+void FakeHardware::pinChange(uint8_t pin) {
+  uint8_t group = digitalPinToPCICRbit(pin);
+  volatile uint8_t* pcmsk = digitalPinToPCMSK(pin);
+  if (!(PCICR & _BV(group)) || !(*pcmsk & _BV(digitalPinToPCMSKbit(pin)))) {
+    return;
+  }
+  woken = true;
+  void (*vector)(void) = group == 0 ? PCINT0_vect : (group == 1 ? PCINT1_vect : PCINT2_vect);
+  if (vector != nullptr) {
+    vector();
+  }
+}
+
+void FakeHardware::setComparator(bool high) {
+  if (static_cast<bool>(ACSR & _BV(ACO)) == high) {
+    return;
+  }
+  ACSR.value = high ? (ACSR.value | _BV(ACO)) : (ACSR.value & ~_BV(ACO));
+  // Not a wake-up source in power-down; the encoder pin's pin change is
+  if ((ACSR & _BV(ACIE)) && !asleep && ANALOG_COMP_vect != nullptr) {
+    ANALOG_COMP_vect();
+  }
+}
+
+void FakeHardware::interruptHandler(uint8_t interruptNum, void (*handler)(), int mode) {
+  if (interruptNum < 2) {
+    interruptHandlers[interruptNum] = handler;
+    interruptModes[interruptNum] = mode;
+  }
+}
+
+// --- Peripherals --------------------------------------------------------------
+
+void FakeHardware::setDisplayPresent(bool present) {
+  displayPresent = present;
+}
+
+void FakeHardware::serialInput(char c) {
+  serialIn.push_back(c);
+}
+
+std::string FakeHardware::takeSerialOutput() {
+  std::string out;
+  out.swap(serialOut);
+  return out;
+}
+
+uint8_t* FakeHardware::eeprom() {
+  return eepromBytes;
+}
+
+uint32_t FakeHardware::longestWatchdogGapMicros() {
+  return static_cast<uint32_t>(longestFeedGap);
+}
+
+void FakeHardware::armWatchdog(bool armed) {
+  feedWatchdog();
+  watchdogArmed = armed;
+}
+
+void FakeHardware::feedWatchdog() {
+  if (watchdogArmed && now - lastFeed > longestFeedGap) {
+    longestFeedGap = now - lastFeed;
+  }
+  lastFeed = now;
+}
+
+// --- Arduino core -------------------------------------------------------------
+
+unsigned long millis() {
+  return static_cast<unsigned long>(now / 1000);
+}
+
+unsigned long micros() {
+  return static_cast<unsigned long>(now);
+}
+
+void delay(unsigned long ms) {
+  FakeHardware::advance(static_cast<uint64_t>(ms) * 1000);
+}
+
+void delayMicroseconds(unsigned int us) {
+  FakeHardware::advance(us);
+}
+
+void pinMode(uint8_t pin, uint8_t mode) {
+  uint8_t mask = pinMask(pin);
+  if (mode == OUTPUT) {
+    *directionRegister(pin) |= mask;
+    return;
+  }
+  *directionRegister(pin) &= ~mask;
+  if (mode == INPUT_PULLUP) {
+    *outputRegister(pin) |= mask;
+  } else {
+    *outputRegister(pin) &= ~mask;
+  }
+}
+
+int digitalRead(uint8_t pin) {
+  return FakeHardware::getPin(pin) ? HIGH : LOW;
+}
+
+void digitalWrite(uint8_t pin, uint8_t value) {
+  if (value) {
+    *outputRegister(pin) |= pinMask(pin);
+  } else {
+    *outputRegister(pin) &= ~pinMask(pin);
+  }
+}
+
+void attachInterrupt(uint8_t interruptNum, void (*handler)(), int mode) {
+  FakeHardware::interruptHandler(interruptNum, handler, mode);
+}
+
+void detachInterrupt(uint8_t interruptNum) {
+  FakeHardware::interruptHandler(interruptNum, nullptr, 0);
+}
+
+// Interrupts only run from advance() and sleep(), never inside firmware code
+void noInterrupts() {}
+void interrupts() {}
+
+void sleep_cpu() {
+  FakeHardware::sleep();
+}
+
+// --- Print and Serial ---------------------------------------------------------
+
+size_t Print::write(const uint8_t* buffer, size_t size) {
+  for (size_t i = 0; i < size; i++) {
+    write(buffer[i]);
+  }
+  return size;
+}
+
+size_t Print::write(const char* str) {
+  return write(reinterpret_cast<const uint8_t*>(str), strlen(str));
+}
+
+size_t Print::printNumber(unsigned long value, int base) {
+  char digits[8 * sizeof(long) + 1];
+  char* p = &digits[sizeof(digits) - 1];
+  *p = '\0';
+  do {
+    unsigned long digit = value % base;
+    *--p = static_cast<char>(digit < 10 ? '0' + digit : 'A' + digit - 10);
+    value /= base;
+  } while (value != 0);
+  return write(p);
+}
+
+size_t Print::print(const __FlashStringHelper* str) {
+  return write(reinterpret_cast<const char*>(str));
+}
+
+size_t Print::print(const char* str) {
+  return write(str);
+}
+
+size_t Print::print(char c) {
+  return write(static_cast<uint8_t>(c));
+}
+
+size_t Print::print(unsigned char value, int base) {
+  return printNumber(value, base);
+}
+
+size_t Print::print(int value, int base) {
+  return print(static_cast<long>(value), base);
+}
+
+size_t Print::print(unsigned int value, int base) {
+  return printNumber(value, base);
+}
+
+size_t Print::print(long value, int base) {
+  if (base == DEC && value < 0) {
+    return print('-') + printNumber(static_cast<unsigned long>(-value), base);
+  }
+  return printNumber(static_cast<unsigned long>(value), base);
+}
+
+size_t Print::print(unsigned long value, int base) {
+  return printNumber(value, base);
+}
+
+size_t Print::print(double value, int digits) {
+  char text[32];
+  snprintf(text, sizeof(text), "%.*f", digits, value);
+  return write(text);
+}
+
+size_t Print::println() {
+  return write("\r\n");
+}
+
+size_t Print::println(const __FlashStringHelper* str) {
+  return print(str) + println();
+}
+
+size_t Print::println(const char* str) {
+  return print(str) + println();
+}
+
+size_t Print::println(char c) {
+  return print(c) + println();
+}
+
+size_t Print::println(unsigned char value, int base) {
+  return print(value, base) + println();
+}
+
+size_t Print::println(int value, int base) {
+  return print(value, base) + println();
+}
+
+size_t Print::println(unsigned int value, int base) {
+  return print(value, base) + println();
+}
+
+size_t Print::println(long value, int base) {
+  return print(value, base) + println();
+}
+
+size_t Print::println(unsigned long value, int base) {
+  return print(value, base) + println();
+}
+
+size_t Print::println(double value, int digits) {
+  return print(value, digits) + println();
+}
+
+static const uint8_t SERIAL_TX_BUFFER_SIZE = 64;
+
+static uint32_t serialQueued() {
+  uint64_t now = FakeHardware::nowMicros();
+  if (FakeHardware::serialIdleAt <= now) {
+    return 0;
+  }
+  return static_cast<uint32_t>((FakeHardware::serialIdleAt - now + FakeHardware::serialByteMicros - 1) /
+                               FakeHardware::serialByteMicros);
+}
+
+void HardwareSerial::begin(unsigned long baud) {
+  FakeHardware::serialByteMicros = static_cast<uint32_t>((10000000UL + baud / 2) / baud);
+}
+
+int HardwareSerial::available() {
+  return static_cast<int>(FakeHardware::serialIn.size());
+}
+
+int HardwareSerial::read() {
+  if (FakeHardware::serialIn.empty()) {
+    return -1;
+  }
+  char c = FakeHardware::serialIn.front();
+  FakeHardware::serialIn.erase(FakeHardware::serialIn.begin());
+  return static_cast<uint8_t>(c);
+}
+
+int HardwareSerial::availableForWrite() {
+  uint32_t queued = serialQueued();
+  return queued >= SERIAL_TX_BUFFER_SIZE - 1 ? 0 : SERIAL_TX_BUFFER_SIZE - 1 - queued;
+}
+
+void HardwareSerial::flush() {
+  uint64_t now = FakeHardware::nowMicros();
+  if (FakeHardware::serialIdleAt > now) {
+    FakeHardware::advance(FakeHardware::serialIdleAt - now);
+  }
+}
+
+size_t HardwareSerial::write(uint8_t c) {
+  // A full buffer blocks until the UART has shifted a byte out
+  uint32_t queued = serialQueued();
+  if (queued >= SERIAL_TX_BUFFER_SIZE) {
+    FakeHardware::advance(static_cast<uint64_t>(queued - SERIAL_TX_BUFFER_SIZE + 1) * FakeHardware::serialByteMicros);
+  }
+  uint64_t now = FakeHardware::nowMicros();
+  uint64_t start = FakeHardware::serialIdleAt > now ? FakeHardware::serialIdleAt : now;
+  FakeHardware::serialIdleAt = start + FakeHardware::serialByteMicros;
+  FakeHardware::serialOut += static_cast<char>(c);
+  return 1;
+}
+
+// --- EEPROM -------------------------------------------------------------------
+
+uint8_t EEPROMClass::read(int address) {
+  return eepromBytes[address];
+}
+
+void EEPROMClass::write(int address, uint8_t value) {
+  eepromBytes[address] = value;
+  FakeHardware::advance(FakeHardware::EEPROM_WRITE_US);
+}
+
+void EEPROMClass::update(int address, uint8_t value) {
+  if (eepromBytes[address] != value) {
+    write(address, value);
+  }
+}
+
+uint16_t EEPROMClass::length() {
+  return FakeHardware::EEPROM_SIZE;
+}
+
+// --- I2C and panel ------------------------------------------------------------
+
+void TwoWire::begin() {}
+
+void TwoWire::end() {}
+
+void TwoWire::setClock(uint32_t newClock) {
+  clock = newClock;
+}
+
+void TwoWire::setWireTimeout(uint32_t, bool) {}
+
+bool TwoWire::getWireTimeoutFlag() {
+  return false;
+}
+
+void TwoWire::clearWireTimeoutFlag() {}
+
+void TwoWire::beginTransmission(uint8_t address) {
+  target = address;
+  pending = 1;
+}
+
+uint8_t TwoWire::endTransmission(bool) {
+  // 9 clocks per byte including the ack
+  FakeHardware::advance(static_cast<uint64_t>(pending) * 9 * 1000000 / clock);
+  pending = 0;
+  return displayPresent && target == FakeHardware::PANEL_ADDRESS ? 0 : 2; // 2: address not acked
+}
+
+size_t TwoWire::write(uint8_t) {
+  pending++;
+  return 1;
+}
+
+size_t TwoWire::write(const uint8_t*, size_t length) {
+  pending += length;
+  return length;
+}
+
+static const uint8_t INIT_SEQUENCE_BYTES = 26;
+
+Adafruit_SSD1306::Adafruit_SSD1306(uint8_t w, uint8_t h, TwoWire* twi, int8_t, uint32_t, uint32_t)
+    : Adafruit_GFX(w, h), wire(twi), address(0), buffer(nullptr) {}
+
+Adafruit_SSD1306::~Adafruit_SSD1306() {
+  free(buffer);
+}
+
+bool Adafruit_SSD1306::begin(uint8_t, uint8_t i2caddr, bool, bool) {
+  if (buffer == nullptr) {
+    buffer = static_cast<uint8_t*>(malloc(width * ((height + 7) / 8)));
+  }
+  address = i2caddr;
+  clearDisplay();
+  commands(INIT_SEQUENCE_BYTES);
+  return true;
+}
+
+void Adafruit_SSD1306::clearDisplay() {
+  memset(buffer, 0, width * ((height + 7) / 8));
+}
+
+void Adafruit_SSD1306::dim(bool) {
+  commands(2); // Contrast command and value
+}
+
+void Adafruit_SSD1306::ssd1306_command(uint8_t) {
+  commands(1);
+}
+
+uint8_t* Adafruit_SSD1306::getBuffer() {
+  return buffer;
+}
+
+void Adafruit_SSD1306::commands(uint8_t count) {
+  wire->setClock(400000);
+  wire->beginTransmission(address);
+  wire->write(static_cast<uint8_t>(0)); // Command stream
+  for (uint8_t i = 0; i < count; i++) {
+    wire->write(static_cast<uint8_t>(0));
+  }
+  wire->endTransmission();
+  wire->setClock(100000);
+}
+
+// --- Watchdog and memory monitor (AVR-only sources are not built) -------------
+
+void Watchdog::arm() {
+  FakeHardware::armWatchdog(true);
+}
+
+void Watchdog::disarm() {
+  FakeHardware::armWatchdog(false);
+}
+
+void Watchdog::feed() {
+  FakeHardware::feedWatchdog();
+}
+
+void Watchdog::setContext(uint8_t) {}
+
+uint8_t Watchdog::getResetFlags() {
+  return _BV(PORF);
+}
+
+uint8_t Watchdog::getLastContext() {
+  return 0;
+}
+
+uint16_t MemoryMonitor::getFreeMemory() {
+  return 0; // No SRAM model
+}
+
+uint16_t MemoryMonitor::getStackHighWater() {
+  return 0;
+}
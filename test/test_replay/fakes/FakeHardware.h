@@ -0,0 +1,69 @@
+#ifndef FAKEHARDWARE_H
+#define FAKEHARDWARE_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+// Something outside the chip that changes pin levels at known times: the desk
+// plant, a scripted user or a recorded trace
+class InputSource {
+public:
+  virtual ~InputSource() {}
+  virtual uint64_t nextEventMicros() = 0; // FakeHardware::NO_EVENT when nothing is scheduled
+  virtual void fire(uint64_t nowMicros) = 0;
+};
+
+// Virtual-time ATmega328P for running the firmware on the host.
+//
+// Time only moves while the firmware waits: delay(), I2C transfers, EEPROM
+// writes, a full serial transmit buffer and power-down sleep. While it moves,
+// the input sources run at their scheduled times, and their pin changes raise
+// the interrupts the chip would: INT0/INT1 on D2/D3, the pin-change groups
+// enabled in PCICR/PCMSKn and the analog comparator on ACO. In power-down
+// INT0/INT1 stay quiet and an enabled pin change wakes the CPU. millis()
+// keeps running through sleep, unlike on the chip; a recorded trace has no
+// time gap there, so a replay lines up either way.
+class FakeHardware {
+public:
+  static const uint64_t NO_EVENT = UINT64_MAX;
+  static const uint8_t PANEL_ADDRESS = 0x3C;
+  static const uint16_t EEPROM_SIZE = 1024;
+  static const uint32_t EEPROM_WRITE_US = 3400;
+
+  static void reset(); // Time 0, buttons released, erased EEPROM, no sources, panel present
+  static void addSource(InputSource* source);
+  static uint64_t nowMicros();
+  static void jumpTo(uint64_t micros); // Move the clock forward without running sources
+  static void advance(uint64_t micros);
+  static void sleep(); // sleep_cpu(): until a pin change wakes the CPU
+  static bool isAsleep();
+  static bool sleptForever(); // Slept with nothing left that could wake it
+
+  // Levels driven from outside, Arduino pin numbers
+  static void setPin(uint8_t pin, bool high);
+  static bool getPin(uint8_t pin);
+  static void setComparator(bool high); // ACO: AIN0 above AIN1
+
+  static void setDisplayPresent(bool present);
+  static void serialInput(char c);
+  static std::string takeSerialOutput(); // Everything sent since the last call
+  static uint8_t* eeprom();
+  static uint32_t longestWatchdogGapMicros(); // Longest stretch between feeds while armed
+
+  // Used by the fakes
+  static uint32_t serialByteMicros;
+  static uint64_t serialIdleAt; // When the transmit buffer runs empty
+  static std::string serialOut;
+  static std::vector<char> serialIn;
+  static void interruptHandler(uint8_t interruptNum, void (*handler)(), int mode);
+  static void armWatchdog(bool armed);
+  static void feedWatchdog();
+
+private:
+  static InputSource* nextSource(uint64_t limit, uint64_t& when);
+  static void externalInterrupt(uint8_t interruptNum, bool high);
+  static void pinChange(uint8_t pin);
+};
+
+#endif // FAKEHARDWARE_H
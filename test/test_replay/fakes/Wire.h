@@ -0,0 +1,30 @@
+#ifndef FAKE_WIRE_H
+#define FAKE_WIRE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// I2C master; a transfer takes its bit time at the set clock and is acked when
+// the panel is present (FakeHardware::setDisplayPresent)
+class TwoWire {
+public:
+  void begin();
+  void end();
+  void setClock(uint32_t clock);
+  void setWireTimeout(uint32_t timeout = 25000, bool resetWithTimeout = false);
+  bool getWireTimeoutFlag();
+  void clearWireTimeoutFlag();
+  void beginTransmission(uint8_t address);
+  uint8_t endTransmission(bool sendStop = true);
+  size_t write(uint8_t data);
+  size_t write(const uint8_t* data, size_t length);
+
+private:
+  uint32_t clock = 100000;
+  uint8_t target = 0;
+  size_t pending = 0; // Bytes of the transmission in progress, with the address
+};
+
+extern TwoWire Wire;
+
+#endif // FAKE_WIRE_H
@@ -0,0 +1,15 @@
+#ifndef FAKE_AVR_INTERRUPT_H
+#define FAKE_AVR_INTERRUPT_H
+
+// Vectors are plain functions; FakeHardware calls them on the matching pin changes
+#define ISR(vector, ...) extern "C" void vector(void)
+#define EMPTY_INTERRUPT(vector) \
+  extern "C" void vector(void) {}
+
+#define cli() noInterrupts()
+#define sei() interrupts()
+
+void noInterrupts();
+void interrupts();
+
+#endif // FAKE_AVR_INTERRUPT_H
@@ -0,0 +1,60 @@
+#ifndef FAKE_AVR_IO_H
+#define FAKE_AVR_IO_H
+
+#include <stdint.h>
+
+// ATmega328P registers the firmware touches, as plain variables. PINx hold the
+// levels driven from outside (FakeHardware::setPin); the firmware only reads them.
+extern volatile uint8_t PINB, DDRB, PORTB;
+extern volatile uint8_t PINC, DDRC, PORTC;
+extern volatile uint8_t PIND, DDRD, PORTD;
+extern volatile uint8_t PCICR, PCIFR, PCMSK0, PCMSK1, PCMSK2;
+extern volatile uint8_t ADCSRB;
+extern volatile uint8_t MCUSR, WDTCSR;
+extern volatile uint8_t TCCR1A, TCCR1B;
+extern volatile uint16_t ICR1, OCR1A, OCR1B, TCNT1;
+extern volatile uint8_t TCCR2A, TCCR2B, OCR2A, TCNT2;
+
+#define _BV(bit) (1 << (bit))
+
+// MCUSR
+#define PORF 0
+#define EXTRF 1
+#define BORF 2
+#define WDRF 3
+
+// WDTCSR
+#define WDIE 6
+
+// ACSR, ADCSRB
+#define ACO 5
+#define ACIE 3
+#define ACME 6
+
+// Timer1, Timer2
+#define WGM11 1
+#define COM1B1 5
+#define COM1A1 7
+#define CS10 0
+#define WGM13 4
+#define WGM20 0
+#define COM2A1 7
+#define CS20 0
+
+// ACO is read-only on the chip: a write keeps the comparator output, which
+// only FakeHardware::setComparator changes (through value)
+struct ComparatorStatus {
+  uint8_t value;
+
+  ComparatorStatus& operator=(uint8_t bits) {
+    value = (bits & ~_BV(ACO)) | (value & _BV(ACO));
+    return *this;
+  }
+
+  operator uint8_t() const {
+    return value;
+  }
+};
+extern ComparatorStatus ACSR;
+
+#endif // FAKE_AVR_IO_H
@@ -0,0 +1,14 @@
+#ifndef FAKE_AVR_PGMSPACE_H
+#define FAKE_AVR_PGMSPACE_H
+
+#include <stdint.h>
+#include <string.h>
+
+// One address space on the host
+#define PROGMEM
+#define PSTR(s) (s)
+#define pgm_read_byte(address) (*reinterpret_cast<const uint8_t*>(address))
+#define pgm_read_word(address) (*reinterpret_cast<const uint16_t*>(address))
+#define memcpy_P memcpy
+
+#endif // FAKE_AVR_PGMSPACE_H
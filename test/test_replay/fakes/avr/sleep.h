@@ -0,0 +1,12 @@
+#ifndef FAKE_AVR_SLEEP_H
+#define FAKE_AVR_SLEEP_H
+
+#define SLEEP_MODE_PWR_DOWN 2
+
+inline void set_sleep_mode(int) {}
+inline void sleep_enable() {}
+inline void sleep_disable() {}
+inline void sleep_bod_disable() {}
+void sleep_cpu(); // Power-down until a pin change (FakeHardware)
+
+#endif // FAKE_AVR_SLEEP_H
@@ -0,0 +1,8 @@
+#ifndef FAKE_UTIL_ATOMIC_H
+#define FAKE_UTIL_ATOMIC_H
+
+// Interrupts only run while time advances, never inside a block
+#define ATOMIC_RESTORESTATE 0
+#define ATOMIC_BLOCK(type) for (bool atomicOnce = true; atomicOnce; atomicOnce = false)
+
+#endif // FAKE_UTIL_ATOMIC_H
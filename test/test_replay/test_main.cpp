@@ -0,0 +1,158 @@
+#include <unity.h>
+
+#include <fstream>
+#include <sstream>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "DeskPlant.h"
+#include "Replay.h"
+#include "TraceRecorder.h"
+
+void setUp() {}
+void tearDown() {}
+
+static uint64_t ms(uint32_t t) {
+  return t * 1000ULL;
+}
+
+static void printDifferences(const ReplayReport& report) {
+  printf("  %u of %u outputs matched, %ld of %ld slits, longest watchdog gap %u ms\n",
+         static_cast<unsigned>(report.matched), static_cast<unsigned>(report.outputs), report.replayedSlits,
+         report.recordedSlits, static_cast<unsigned>(report.longestWatchdogGapMs));
+  size_t shown = report.differences.size() < 20 ? report.differences.size() : 20;
+  for (size_t i = 0; i < shown; i++) {
+    printf("  %s\n", report.differences[i].c_str());
+  }
+  if (shown < report.differences.size()) {
+    printf("  ... %u more\n", static_cast<unsigned>(report.differences.size() - shown));
+  }
+}
+
+// A calibrated desk at 750 mm (10 slits/mm, preset 2 at 800 mm), driven by a
+// scripted user on the simulated desk with a live trace running
+static std::string recordSession() {
+  FakeHardware::reset();
+  Replay::resetFirmware();
+  {
+    DeskState seed;
+    seed.init();
+    seed.setHeightOffset(0.0f); // Erased, it reads as NaN
+    seed.setEncoderSlitsPerMM(10.0f);
+    seed.savePreset(1, 800.0f);
+    seed.setPulseCount(7500);
+    seed.setCalibrated(true);
+  }
+
+  DeskPlant plant(750.0f, 10.0f);
+  InputSchedule user;
+  user.command(ms(2000), 'T');
+  user.pin(ms(3000), UP_BUTTON_PIN, false); // Drive up for 2 s
+  user.pin(ms(5000), UP_BUTTON_PIN, true);
+  user.pin(ms(7000), DOWN_BUTTON_PIN, false); // and down for 1 s
+  user.pin(ms(8000), DOWN_BUTTON_PIN, true);
+  user.command(ms(9000), 's');
+  user.pin(ms(10000), UP_BUTTON_PIN, false); // Chord held into preset mode
+  user.pin(ms(10020), DOWN_BUTTON_PIN, false);
+  user.pin(ms(12300), UP_BUTTON_PIN, true);
+  user.pin(ms(12300), DOWN_BUTTON_PIN, true);
+  user.pin(ms(13000), UP_BUTTON_PIN, false); // Next preset
+  user.pin(ms(13100), UP_BUTTON_PIN, true);
+  user.pin(ms(14000), UP_BUTTON_PIN, false); // Chord tap: go there
+  user.pin(ms(14010), DOWN_BUTTON_PIN, false);
+  user.pin(ms(14300), UP_BUTTON_PIN, true);
+  user.pin(ms(14310), DOWN_BUTTON_PIN, true);
+  user.command(ms(20000), 'T');
+  FakeHardware::addSource(&plant);
+  FakeHardware::addSource(&user);
+
+  Desk* desk = new Desk();
+  Serial.begin(115200);
+  desk->init();
+  Replay::runLoop(*desk, ms(21000));
+  delete desk;
+  return FakeHardware::takeSerialOutput();
+}
+
+void test_live_trace_is_complete() {
+  LiveCapture capture;
+  TEST_ASSERT_TRUE(parseLiveCapture(recordSession(), capture));
+  TEST_ASSERT_TRUE(capture.complete);
+  TEST_ASSERT_EQUAL(0, capture.lost);
+  TEST_ASSERT_TRUE(capture.startMs >= 2000 && capture.startMs < 2050); // After the EEPROM save
+  TEST_ASSERT_EQUAL(7500, capture.startPulses);
+  TEST_ASSERT_TRUE(!capture.eeprom.empty());
+
+  long slits = 0;
+  unsigned motor = 0;
+  unsigned commands = 0;
+  for (const TraceLine& entry : capture.entries) {
+    slits += entry.kind == TraceRecorder::ENCODER_A ? abs(entry.data) : 0;
+    motor += entry.kind == TraceRecorder::MOTOR;
+    commands += entry.kind == TraceRecorder::COMMAND;
+  }
+  TEST_ASSERT_TRUE(slits > 300); // Up 2 s, down 1 s and the preset move, at up to 40 mm/s
+  TEST_ASSERT_TRUE(motor >= 6); // Start and stop of each of the three moves
+  TEST_ASSERT_EQUAL(2, commands); // 's' and the closing 'T'
+}
+
+void test_replay_matches_recording() {
+  LiveCapture capture;
+  TEST_ASSERT_TRUE(parseLiveCapture(recordSession(), capture));
+
+  ReplayReport report = Replay::run(capture);
+  printDifferences(report);
+  TEST_ASSERT_TRUE(report.replayComplete);
+  TEST_ASSERT_TRUE(report.sameEeprom);
+  TEST_ASSERT_EQUAL(report.recordedSlits, report.replayedSlits);
+  TEST_ASSERT_EQUAL(report.outputs, report.matched);
+  TEST_ASSERT_EQUAL(0, report.differences.size());
+  TEST_ASSERT_TRUE(report.longestWatchdogGapMs < 250);
+}
+
+void test_replay_reports_a_different_run() {
+  LiveCapture capture;
+  TEST_ASSERT_TRUE(parseLiveCapture(recordSession(), capture));
+
+  // Without the chord tap the replay never starts the preset move
+  std::vector<TraceLine> entries;
+  for (const TraceLine& entry : capture.entries) {
+    if (entry.kind != TraceRecorder::BUTTON || entry.timeMs < 14000 || entry.timeMs > 14400) {
+      entries.push_back(entry);
+    }
+  }
+  capture.entries = entries;
+
+  ReplayReport report = Replay::run(capture);
+  TEST_ASSERT_TRUE(report.matched < report.outputs);
+  TEST_ASSERT_FALSE(report.differences.empty());
+}
+
+// REPLAY_TRACE=session.log: the serial log of a 'T' session on a real desk
+void test_replay_recorded_trace() {
+  const char* path = getenv("REPLAY_TRACE");
+  if (path == nullptr) {
+    return;
+  }
+  std::ifstream file(path);
+  std::stringstream log;
+  log << file.rdbuf();
+  LiveCapture capture;
+  TEST_ASSERT_TRUE(parseLiveCapture(log.str(), capture));
+  if (!capture.complete || capture.lost != 0) {
+    printf("  incomplete trace (%u entries lost): outputs after the gap may differ\n", capture.lost);
+  }
+
+  ReplayReport report = Replay::run(capture);
+  printDifferences(report);
+  TEST_ASSERT_EQUAL(0, report.differences.size());
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_live_trace_is_complete);
+  RUN_TEST(test_replay_matches_recording);
+  RUN_TEST(test_replay_reports_a_different_run);
+  RUN_TEST(test_replay_recorded_trace);
+  return UNITY_END();
+}